@@ -3,44 +3,267 @@
 #include <aria/address.h>
 #include <aria/slab.h>
 #include <aria/string.h>
+#include <aria/random.h>
 #include <aria/aslr.h>
 
+#define ASLR_GAP_AUGMENT(NODE) aslr_gap_augment(NODE)
+
+/* Deepest red-black tree over all gaps a 64-bit address space can hold */
+#define ASLR_MAX_DEPTH 128
+
+static inline void aslr_gap_augment(struct aslr_gap *gap)
+{
+	gap->subtree_pages = gap->pages;
+	gap->subtree_count = 1;
+
+	if (gap->left) {
+		gap->subtree_pages += gap->left->subtree_pages;
+		gap->subtree_count += gap->left->subtree_count;
+	}
+	if (gap->right) {
+		gap->subtree_pages += gap->right->subtree_pages;
+		gap->subtree_count += gap->right->subtree_count;
+	}
+}
+
+/* Placements of pages long layouts in a subtree of gaps that all fit them */
+static inline size_t aslr_subtree_weight(struct aslr_gap *gap, size_t pages)
+{
+	if (gap == NULL)
+		return 0;
+
+	return gap->subtree_pages - gap->subtree_count * (pages - 1);
+}
+
+static int aslr_insert_gap(struct aslr *aslr, struct aslr_gap *gap,
+						   uintptr_t start, size_t pages)
+{
+	gap->start = start;
+	gap->pages = pages;
+
+	return RB_AUGMENTED_INSERT(aslr->gaps, pages, gap, ASLR_GAP_AUGMENT);
+}
+
+/* First page boundary at or above address that no layout covers */
+static uintptr_t aslr_skip_layouts(struct aslr *aslr, uintptr_t address)
+{
+	struct aslr_layout *layout = aslr->layout;
+
+	while (layout) {
+		uintptr_t lower = layout->lower_bound & ~(PAGE_SIZE - 1);
+		uintptr_t upper = ALIGN_UP(layout->upper_bound, PAGE_SIZE);
+
+		if (lower <= address && address < upper) {
+			address = upper;
+			layout = aslr->layout;
+			continue;
+		}
+
+		layout = layout->next;
+	}
+
+	return address;
+}
+
+/* Lowest page boundary of a layout above address, or end */
+static uintptr_t aslr_next_layout(struct aslr *aslr, uintptr_t address,
+								  uintptr_t end)
+{
+	for (struct aslr_layout *layout = aslr->layout; layout;
+		 layout = layout->next) {
+		uintptr_t lower = layout->lower_bound & ~(PAGE_SIZE - 1);
+		if (layout->upper_bound > layout->lower_bound && lower > address &&
+			lower < end)
+			end = lower;
+	}
+
+	return end;
+}
+
+static void aslr_free_gaps(struct aslr *aslr)
+{
+	while (aslr->gaps) {
+		struct aslr_gap *gap = aslr->gaps;
+
+		RB_AUGMENTED_DELETE(aslr->gaps, gap, ASLR_GAP_AUGMENT);
+		free(gap);
+	}
+}
+
+int aslr_init(struct aslr *aslr)
+{
+	if (unlikely(aslr == NULL))
+		return -1;
+
+	aslr_free_gaps(aslr);
+
+	uintptr_t start = ALIGN_UP(aslr->minimum_vaddr, PAGE_SIZE);
+	uintptr_t end = aslr->maximum_vaddr & ~(PAGE_SIZE - 1);
+
+	/* Layouts placed before the tree existed are not free */
+	while (start < end) {
+		start = aslr_skip_layouts(aslr, start);
+		if (start >= end)
+			break;
+
+		uintptr_t limit = aslr_next_layout(aslr, start, end);
+
+		struct aslr_gap *gap = alloc(sizeof(struct aslr_gap));
+		if (unlikely(gap == NULL)) {
+			aslr_free_gaps(aslr);
+			return -1;
+		}
+
+		aslr_insert_gap(aslr, gap, start, (limit - start) / PAGE_SIZE);
+		start = limit;
+	}
+
+	aslr->gaps_ready = true;
+
+	return 0;
+}
+
+/*
+ * Pick one of the placements of a pages long layout uniformly. The gaps
+ * that fit are a suffix of the size order, which a single descent splits
+ * into single gaps and whole right subtrees. Returns the gap and sets
+ * offset to the page within it, or NULL if nothing fits.
+ */
+static struct aslr_gap *aslr_select_gap(struct aslr *aslr, size_t pages,
+										size_t *offset)
+{
+	struct aslr_gap *pieces[ASLR_MAX_DEPTH * 2];
+	size_t weights[ASLR_MAX_DEPTH * 2];
+	bool subtree[ASLR_MAX_DEPTH * 2];
+	size_t count = 0, total = 0;
+
+	for (struct aslr_gap *gap = aslr->gaps; gap;) {
+		if (gap->pages < pages) {
+			gap = gap->right;
+			continue;
+		}
+
+		pieces[count] = gap;
+		subtree[count] = false;
+		weights[count] = gap->pages - pages + 1;
+		total += weights[count++];
+
+		if (gap->right) {
+			pieces[count] = gap->right;
+			subtree[count] = true;
+			weights[count] = aslr_subtree_weight(gap->right, pages);
+			total += weights[count++];
+		}
+
+		gap = gap->left;
+	}
+
+	if (total == 0)
+		return NULL;
+
+	size_t rank = random_range(total);
+
+	size_t i = 0;
+	for (; rank >= weights[i]; i++)
+		rank -= weights[i];
+
+	struct aslr_gap *gap = pieces[i];
+	if (!subtree[i]) {
+		*offset = rank;
+		return gap;
+	}
+
+	for (;;) {
+		size_t left = aslr_subtree_weight(gap->left, pages);
+		if (rank < left) {
+			gap = gap->left;
+			continue;
+		}
+		rank -= left;
+
+		size_t own = gap->pages - pages + 1;
+		if (rank < own) {
+			*offset = rank;
+			return gap;
+		}
+		rank -= own;
+
+		gap = gap->right;
+	}
+}
+
+/* Take pages at offset out of gap, leaving what remains on either side */
+static int aslr_split_gap(struct aslr *aslr, struct aslr_gap *gap,
+						  size_t offset, size_t pages)
+{
+	uintptr_t start = gap->start;
+	size_t after = gap->pages - offset - pages;
+
+	struct aslr_gap *spare = NULL;
+	if (offset && after) {
+		spare = alloc(sizeof(struct aslr_gap));
+		if (unlikely(spare == NULL))
+			return -1;
+	}
+
+	RB_AUGMENTED_DELETE(aslr->gaps, gap, ASLR_GAP_AUGMENT);
+
+	if (offset) {
+		aslr_insert_gap(aslr, gap, start, offset);
+		gap = spare;
+	}
+
+	if (after)
+		aslr_insert_gap(aslr, gap, start + (offset + pages) * PAGE_SIZE,
+						after);
+	else if (offset == 0)
+		free(gap);
+
+	return 0;
+}
+
 int aslr_generate_layout(struct aslr *aslr, struct aslr_layout **ret,
 						 size_t length)
 {
 	if (unlikely(aslr == NULL || ret == NULL))
 		return -1;
 
+	if (!aslr->gaps_ready && aslr_init(aslr) == -1)
+		return -1;
+
 	struct aslr_layout *layout = alloc(sizeof(struct aslr_layout));
 	if (unlikely(layout == NULL))
 		return -1;
 
-	*ret = layout;
+	size_t pages = DIV_ROUNDUP(length, PAGE_SIZE);
+	size_t offset;
 
-	for (;;) {
-		layout->lower_bound =
-			ALIGN_UP(aslr->minimum_vaddr +
-						 (({
-							  uint64_t ret;
-							  __asm__ volatile("rdrand %0" : "=r"(ret));
-							  ret;
-						  }) %
-						  (aslr->maximum_vaddr - aslr->minimum_vaddr)),
-					 PAGE_SIZE);
-		layout->upper_bound = layout->lower_bound + length;
-
-		for (struct aslr_layout *root = aslr->layout; root; root = root->next) {
-			if (root->upper_bound <= layout->lower_bound ||
-				layout->upper_bound <= root->lower_bound)
-				continue;
-			else
-				goto next;
+	/*
+	 * An empty layout takes no space, so it gets a base on any free page,
+	 * or the bottom of the range once nothing is left.
+	 */
+	struct aslr_gap *gap = aslr_select_gap(aslr, pages ? pages : 1, &offset);
+	if (gap == NULL && pages) {
+		free(layout);
+		return -1;
+	}
+
+	if (gap == NULL) {
+		layout->lower_bound = ALIGN_UP(aslr->minimum_vaddr, PAGE_SIZE);
+	} else {
+		/* The gap is reused or freed by the split */
+		layout->lower_bound = gap->start + offset * PAGE_SIZE;
+
+		if (pages && aslr_split_gap(aslr, gap, offset, pages) == -1) {
+			free(layout);
+			return -1;
 		}
-		break;
-next:
-		continue;
 	}
 
+	layout->upper_bound = layout->lower_bound + length;
+
+	*ret = layout;
+
 	layout->next = aslr->layout;
 	layout->last = NULL;
 	if (aslr->layout)
@@ -1,8 +1,11 @@
 #ifndef ARIA_ASLR_H_
 #define ARIA_ASLR_H_
 
+#include <aria/rb_tree.h>
+
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 struct aslr_layout {
 	uintptr_t lower_bound;
@@ -12,13 +15,45 @@ struct aslr_layout {
 	struct aslr_layout *last;
 };
 
+/*
+ * Page aligned free range of the address space. Gaps are kept in a tree
+ * ordered by size, where every node also sums the pages and counts the
+ * gaps below it. The gaps large enough for a request then form a suffix
+ * of the tree, and the number of possible placements in it is
+ * pages - count * (request pages - 1) for any whole subtree of that suffix.
+ */
+struct aslr_gap {
+	RB_META(struct aslr_gap)
+
+	uintptr_t start;
+	size_t pages;
+	size_t subtree_pages;
+	size_t subtree_count;
+};
+
 struct aslr {
 	struct aslr_layout *layout;
 
 	uintptr_t minimum_vaddr;
 	uintptr_t maximum_vaddr;
+
+	/* Free space between the bounds that no layout covers */
+	struct aslr_gap *gaps;
+	bool gaps_ready;
 };
 
+/*
+ * Build the gaps from the bounds, leaving out every layout already in the
+ * list. Done on the first placement if not called before, and must be
+ * called again when the bounds change.
+ */
+int aslr_init(struct aslr *aslr);
+
+/*
+ * Place length bytes at a page aligned address drawn uniformly from every
+ * placement that fits, in O(log n) of the number of gaps. Fails if no gap
+ * is large enough. A zero length layout takes no space.
+ */
 int aslr_generate_layout(struct aslr *aslr, struct aslr_layout **ret,
 						 size_t length);
 
@@ -0,0 +1,699 @@
+#include <aria/bptree.h>
+#include <aria/string.h>
+#include <aria/slab.h>
+#include <aria/address.h>
+#include <aria/debug.h>
+
+#include <stdbool.h>
+
+typedef uint64_t bptree_keys_t __attribute__((vector_size(16)));
+
+// Number of keys in node below key. The padding slots hold UINT64_MAX and
+// are never below anything, so this is also the lower bound within node.
+static inline int bptree_rank(const struct bptree_node *node, uint64_t key)
+{
+	bptree_keys_t target = (bptree_keys_t){} + key;
+	bptree_keys_t sum = {};
+
+	for (int i = 0; i < BPTREE_KEY_SLOTS; i += 2) {
+		bptree_keys_t chunk;
+		__builtin_memcpy(&chunk, &node->keys[i], sizeof(chunk));
+		sum -= (bptree_keys_t)(chunk < target);
+	}
+
+	return sum[0] + sum[1];
+}
+
+// Index of the child of an internal node that key belongs under.
+static inline int bptree_child(const struct bptree_node *node, uint64_t key)
+{
+	int index = bptree_rank(node, key);
+	while (index < node->count && node->keys[index] == key)
+		index++;
+	return index;
+}
+
+static inline void bptree_pad(struct bptree_node *node)
+{
+	for (int i = node->count; i < BPTREE_KEY_SLOTS; i++)
+		node->keys[i] = UINT64_MAX;
+}
+
+// alloc rounds size + 1 up to a power of two, so this takes exactly a page.
+#define BPTREE_CHUNK_SIZE (PAGE_SIZE - 1)
+#define BPTREE_NODE_ALIGN 64
+
+static int bptree_chunk_create(struct bptree *tree)
+{
+	struct bptree_chunk *chunk = alloc(BPTREE_CHUNK_SIZE);
+	if (chunk == NULL)
+		return -1;
+
+	chunk->next = tree->chunks;
+	tree->chunks = chunk;
+
+	uintptr_t start = (uintptr_t)(chunk + 1);
+	start = ALIGN_UP(start, BPTREE_NODE_ALIGN);
+	uintptr_t end = (uintptr_t)chunk + BPTREE_CHUNK_SIZE;
+
+	for (; start + sizeof(struct bptree_node) <= end;
+		 start += sizeof(struct bptree_node)) {
+		struct bptree_node *node = (struct bptree_node *)start;
+		node->children[0] = tree->free_nodes;
+		tree->free_nodes = node;
+	}
+
+	return 0;
+}
+
+static struct bptree_node *bptree_node_create(struct bptree *tree, int leaf)
+{
+	if (tree->free_nodes == NULL && bptree_chunk_create(tree) == -1)
+		return NULL;
+
+	struct bptree_node *node = tree->free_nodes;
+	tree->free_nodes = node->children[0];
+
+	memset(node, 0, sizeof(struct bptree_node));
+	node->leaf = leaf;
+	bptree_pad(node);
+
+	return node;
+}
+
+static void bptree_node_free(struct bptree *tree, struct bptree_node *node)
+{
+	node->children[0] = tree->free_nodes;
+	tree->free_nodes = node;
+}
+
+static void bptree_node_destroy(struct bptree *tree, struct bptree_node *node)
+{
+	if (!node->leaf) {
+		for (int i = 0; i <= node->count; i++)
+			bptree_node_destroy(tree, node->children[i]);
+	}
+
+	bptree_node_free(tree, node);
+}
+
+static inline void bptree_clear(struct bptree *tree)
+{
+	tree->root = NULL;
+	tree->size = 0;
+	tree->height = 0;
+}
+
+void bptree_init(struct bptree *tree)
+{
+	bptree_clear(tree);
+	tree->chunks = NULL;
+	tree->free_nodes = NULL;
+}
+
+void bptree_destroy(struct bptree *tree)
+{
+	// Every node lives in one of the chunks, so there is no need to walk
+	// the tree.
+	while (tree->chunks) {
+		struct bptree_chunk *next = tree->chunks->next;
+		free(tree->chunks);
+		tree->chunks = next;
+	}
+
+	bptree_init(tree);
+}
+
+static struct bptree_node *bptree_find_leaf(struct bptree *tree, uint64_t key)
+{
+	struct bptree_node *node = tree->root;
+
+	while (node && !node->leaf)
+		node = node->children[bptree_child(node, key)];
+
+	return node;
+}
+
+int bptree_find(struct bptree *tree, uint64_t key, void **value)
+{
+	if (tree == NULL || value == NULL)
+		RETURN_ERROR;
+
+	struct bptree_node *leaf = bptree_find_leaf(tree, key);
+	if (leaf == NULL)
+		return -1;
+
+	int index = bptree_rank(leaf, key);
+	if (index == leaf->count || leaf->keys[index] != key)
+		return -1;
+
+	*value = leaf->values[index];
+
+	return 0;
+}
+
+// Insert separator and right child into an internal node that has room.
+static void bptree_internal_insert(struct bptree_node *node, int index,
+								   uint64_t separator,
+								   struct bptree_node *right)
+{
+	memmove(&node->keys[index + 1], &node->keys[index],
+			(node->count - index) * sizeof(uint64_t));
+	memmove(&node->children[index + 2], &node->children[index + 1],
+			(node->count - index) * sizeof(struct bptree_node *));
+
+	node->keys[index] = separator;
+	node->children[index + 1] = right;
+	node->count++;
+}
+
+int bptree_insert(struct bptree *tree, uint64_t key, void *value)
+{
+	if (tree == NULL)
+		RETURN_ERROR;
+
+	if (tree->root == NULL) {
+		tree->root = bptree_node_create(tree, 1);
+		if (tree->root == NULL)
+			RETURN_ERROR;
+		tree->height = 1;
+	}
+
+	struct bptree_node *path[BPTREE_MAX_DEPTH];
+	int indices[BPTREE_MAX_DEPTH];
+	int depth = 0;
+
+	struct bptree_node *node = tree->root;
+	while (!node->leaf) {
+		path[depth] = node;
+		indices[depth] = bptree_child(node, key);
+		node = node->children[indices[depth++]];
+	}
+
+	int index = bptree_rank(node, key);
+	if (index < node->count && node->keys[index] == key) {
+		node->values[index] = value;
+		return 0;
+	}
+
+	if (node->count < BPTREE_MAX_KEYS) {
+		memmove(&node->keys[index + 1], &node->keys[index],
+				(node->count - index) * sizeof(uint64_t));
+		memmove(&node->values[index + 1], &node->values[index],
+				(node->count - index) * sizeof(void *));
+		node->keys[index] = key;
+		node->values[index] = value;
+		node->count++;
+		tree->size++;
+		return 0;
+	}
+
+	// Allocate every node a split can need up front, so that a failed
+	// allocation leaves the tree untouched.
+	struct bptree_node *spare[BPTREE_MAX_DEPTH + 1];
+	int needed = 1;
+	while (needed <= depth && path[depth - needed]->count == BPTREE_MAX_KEYS)
+		needed++;
+	if (needed > depth)
+		needed++;
+
+	for (int i = 0; i < needed; i++) {
+		spare[i] = bptree_node_create(tree, i == 0);
+		if (spare[i] == NULL) {
+			while (i--)
+				bptree_node_free(tree, spare[i]);
+			RETURN_ERROR;
+		}
+	}
+
+	// Split the full leaf around the new entry.
+	uint64_t keys[BPTREE_MAX_KEYS + 1];
+	void *values[BPTREE_MAX_KEYS + 1];
+
+	memcpy(keys, node->keys, index * sizeof(uint64_t));
+	memcpy(values, node->values, index * sizeof(void *));
+	keys[index] = key;
+	values[index] = value;
+	memcpy(&keys[index + 1], &node->keys[index],
+		   (BPTREE_MAX_KEYS - index) * sizeof(uint64_t));
+	memcpy(&values[index + 1], &node->values[index],
+		   (BPTREE_MAX_KEYS - index) * sizeof(void *));
+
+	struct bptree_node *right = spare[0];
+	int left_count = (BPTREE_MAX_KEYS + 1) / 2;
+
+	node->count = left_count;
+	right->count = BPTREE_MAX_KEYS + 1 - left_count;
+	memcpy(node->keys, keys, left_count * sizeof(uint64_t));
+	memcpy(node->values, values, left_count * sizeof(void *));
+	memcpy(right->keys, &keys[left_count], right->count * sizeof(uint64_t));
+	memcpy(right->values, &values[left_count], right->count * sizeof(void *));
+	bptree_pad(node);
+	bptree_pad(right);
+
+	right->next = node->next;
+	right->prev = node;
+	if (node->next)
+		node->next->prev = right;
+	node->next = right;
+
+	uint64_t separator = right->keys[0];
+	int used = 1;
+
+	// Push the separator up, splitting full internal nodes on the way.
+	while (depth > 0) {
+		struct bptree_node *parent = path[--depth];
+		index = indices[depth];
+
+		if (parent->count < BPTREE_MAX_KEYS) {
+			bptree_internal_insert(parent, index, separator, right);
+			tree->size++;
+			return 0;
+		}
+
+		uint64_t pkeys[BPTREE_MAX_KEYS + 1];
+		struct bptree_node *children[BPTREE_MAX_KEYS + 2];
+
+		memcpy(pkeys, parent->keys, index * sizeof(uint64_t));
+		pkeys[index] = separator;
+		memcpy(&pkeys[index + 1], &parent->keys[index],
+			   (BPTREE_MAX_KEYS - index) * sizeof(uint64_t));
+		memcpy(children, parent->children,
+			   (index + 1) * sizeof(struct bptree_node *));
+		children[index + 1] = right;
+		memcpy(&children[index + 2], &parent->children[index + 1],
+			   (BPTREE_MAX_KEYS - index) * sizeof(struct bptree_node *));
+
+		// One more key than fits: the middle one moves up and the rest are
+		// shared between the two halves.
+		struct bptree_node *sibling = spare[used++];
+		int middle = (BPTREE_MAX_KEYS + 1) / 2;
+
+		parent->count = middle;
+		sibling->count = BPTREE_MAX_KEYS - middle;
+		memcpy(parent->keys, pkeys, middle * sizeof(uint64_t));
+		memcpy(parent->children, children,
+			   (middle + 1) * sizeof(struct bptree_node *));
+		memcpy(sibling->keys, &pkeys[middle + 1],
+			   sibling->count * sizeof(uint64_t));
+		memcpy(sibling->children, &children[middle + 1],
+			   (sibling->count + 1) * sizeof(struct bptree_node *));
+		bptree_pad(parent);
+		bptree_pad(sibling);
+
+		separator = pkeys[middle];
+		right = sibling;
+	}
+
+	// The root split, so the tree grows a level.
+	struct bptree_node *root = spare[used];
+	root->count = 1;
+	root->keys[0] = separator;
+	root->children[0] = tree->root;
+	root->children[1] = right;
+
+	tree->root = root;
+	tree->height++;
+	tree->size++;
+
+	return 0;
+}
+
+// Remove entry index from node along with the child to its right.
+static void bptree_internal_remove(struct bptree_node *node, int index)
+{
+	memmove(&node->keys[index], &node->keys[index + 1],
+			(node->count - index - 1) * sizeof(uint64_t));
+	memmove(&node->children[index + 1], &node->children[index + 2],
+			(node->count - index - 1) * sizeof(struct bptree_node *));
+
+	node->count--;
+	bptree_pad(node);
+}
+
+// Refill a leaf that dropped below the minimum from a sibling, or merge it
+// into one. Returns whether the parent lost an entry.
+static bool bptree_rebalance_leaf(struct bptree *tree,
+								  struct bptree_node *parent, int index)
+{
+	struct bptree_node *node = parent->children[index];
+	struct bptree_node *left = index > 0 ? parent->children[index - 1] : NULL;
+	struct bptree_node *right =
+		index < parent->count ? parent->children[index + 1] : NULL;
+
+	if (left && left->count > BPTREE_MIN_KEYS) {
+		memmove(&node->keys[1], node->keys, node->count * sizeof(uint64_t));
+		memmove(&node->values[1], node->values, node->count * sizeof(void *));
+		node->keys[0] = left->keys[left->count - 1];
+		node->values[0] = left->values[left->count - 1];
+		node->count++;
+		left->count--;
+		bptree_pad(left);
+		parent->keys[index - 1] = node->keys[0];
+		return false;
+	}
+
+	if (right && right->count > BPTREE_MIN_KEYS) {
+		node->keys[node->count] = right->keys[0];
+		node->values[node->count] = right->values[0];
+		node->count++;
+		right->count--;
+		memmove(right->keys, &right->keys[1], right->count * sizeof(uint64_t));
+		memmove(right->values, &right->values[1],
+				right->count * sizeof(void *));
+		bptree_pad(right);
+		parent->keys[index] = right->keys[0];
+		return false;
+	}
+
+	// Merge the right one of the pair into the left one.
+	if (left) {
+		right = node;
+		node = left;
+		index--;
+	}
+
+	memcpy(&node->keys[node->count], right->keys,
+		   right->count * sizeof(uint64_t));
+	memcpy(&node->values[node->count], right->values,
+		   right->count * sizeof(void *));
+	node->count += right->count;
+
+	node->next = right->next;
+	if (right->next)
+		right->next->prev = node;
+
+	bptree_node_free(tree, right);
+	bptree_internal_remove(parent, index);
+
+	return true;
+}
+
+static bool bptree_rebalance_internal(struct bptree *tree,
+									  struct bptree_node *parent, int index)
+{
+	struct bptree_node *node = parent->children[index];
+	struct bptree_node *left = index > 0 ? parent->children[index - 1] : NULL;
+	struct bptree_node *right =
+		index < parent->count ? parent->children[index + 1] : NULL;
+
+	if (left && left->count > BPTREE_MIN_KEYS) {
+		memmove(&node->keys[1], node->keys, node->count * sizeof(uint64_t));
+		memmove(&node->children[1], node->children,
+				(node->count + 1) * sizeof(struct bptree_node *));
+		node->keys[0] = parent->keys[index - 1];
+		node->children[0] = left->children[left->count];
+		node->count++;
+		parent->keys[index - 1] = left->keys[left->count - 1];
+		left->count--;
+		bptree_pad(left);
+		return false;
+	}
+
+	if (right && right->count > BPTREE_MIN_KEYS) {
+		node->keys[node->count] = parent->keys[index];
+		node->children[node->count + 1] = right->children[0];
+		node->count++;
+		parent->keys[index] = right->keys[0];
+		memmove(right->keys, &right->keys[1],
+				(right->count - 1) * sizeof(uint64_t));
+		memmove(right->children, &right->children[1],
+				right->count * sizeof(struct bptree_node *));
+		right->count--;
+		bptree_pad(right);
+		return false;
+	}
+
+	if (left) {
+		right = node;
+		node = left;
+		index--;
+	}
+
+	node->keys[node->count] = parent->keys[index];
+	memcpy(&node->keys[node->count + 1], right->keys,
+		   right->count * sizeof(uint64_t));
+	memcpy(&node->children[node->count + 1], right->children,
+		   (right->count + 1) * sizeof(struct bptree_node *));
+	node->count += right->count + 1;
+
+	bptree_node_free(tree, right);
+	bptree_internal_remove(parent, index);
+
+	return true;
+}
+
+int bptree_delete(struct bptree *tree, uint64_t key)
+{
+	if (tree == NULL)
+		RETURN_ERROR;
+	if (tree->root == NULL)
+		return -1;
+
+	struct bptree_node *path[BPTREE_MAX_DEPTH];
+	int indices[BPTREE_MAX_DEPTH];
+	int depth = 0;
+
+	struct bptree_node *node = tree->root;
+	while (!node->leaf) {
+		path[depth] = node;
+		indices[depth] = bptree_child(node, key);
+		node = node->children[indices[depth++]];
+	}
+
+	int index = bptree_rank(node, key);
+	if (index == node->count || node->keys[index] != key)
+		return -1;
+
+	memmove(&node->keys[index], &node->keys[index + 1],
+			(node->count - index - 1) * sizeof(uint64_t));
+	memmove(&node->values[index], &node->values[index + 1],
+			(node->count - index - 1) * sizeof(void *));
+	node->count--;
+	bptree_pad(node);
+	tree->size--;
+
+	// Separators equal to the removed key stay valid bounds, so only an
+	// underflow needs any work above the leaf.
+	bool underflow = node->count < BPTREE_MIN_KEYS;
+	for (int level = depth - 1; underflow && level >= 0; level--) {
+		bool merged =
+			(level == depth - 1) ?
+				bptree_rebalance_leaf(tree, path[level], indices[level]) :
+				bptree_rebalance_internal(tree, path[level], indices[level]);
+		underflow = merged && path[level]->count < BPTREE_MIN_KEYS;
+	}
+
+	struct bptree_node *root = tree->root;
+	if (!root->leaf && root->count == 0) {
+		tree->root = root->children[0];
+		tree->height--;
+		bptree_node_free(tree, root);
+	} else if (root->leaf && root->count == 0) {
+		bptree_node_free(tree, root);
+		bptree_clear(tree);
+	}
+
+	return 0;
+}
+
+int bptree_bulk_load(struct bptree *tree, const uint64_t *keys,
+					 void *const *values, size_t n)
+{
+	if (tree == NULL || tree->root != NULL || (n && (!keys || !values)))
+		RETURN_ERROR;
+	if (n == 0)
+		return 0;
+
+	for (size_t i = 1; i < n; i++) {
+		if (keys[i - 1] >= keys[i])
+			RETURN_ERROR;
+	}
+
+	// Spread the entries evenly over as few leaves as possible, which keeps
+	// every node at or above the minimum fill.
+	size_t count = DIV_ROUNDUP(n, BPTREE_MAX_KEYS);
+	struct bptree_node **level = alloc(count * sizeof(struct bptree_node *));
+	uint64_t *lows = alloc(count * sizeof(uint64_t));
+	if (level == NULL || lows == NULL) {
+		free(level);
+		free(lows);
+		RETURN_ERROR;
+	}
+
+	struct bptree_node *previous = NULL;
+	size_t offset = 0;
+	size_t built, pending;
+
+	for (size_t i = 0; i < count; i++) {
+		struct bptree_node *leaf = bptree_node_create(tree, 1);
+		if (leaf == NULL) {
+			built = i;
+			pending = count;
+			goto fail;
+		}
+
+		leaf->count = n / count + (i < n % count);
+		memcpy(leaf->keys, &keys[offset], leaf->count * sizeof(uint64_t));
+		memcpy(leaf->values, &values[offset], leaf->count * sizeof(void *));
+		bptree_pad(leaf);
+
+		leaf->prev = previous;
+		if (previous)
+			previous->next = leaf;
+		previous = leaf;
+
+		level[i] = leaf;
+		lows[i] = leaf->keys[0];
+		offset += leaf->count;
+	}
+
+	tree->height = 1;
+
+	// Build each internal level over the one below, in place.
+	while (count > 1) {
+		size_t parents = DIV_ROUNDUP(count, BPTREE_MAX_KEYS + 1);
+		size_t child = 0;
+
+		for (size_t i = 0; i < parents; i++) {
+			size_t fanout = count / parents + (i < count % parents);
+
+			struct bptree_node *node = bptree_node_create(tree, 0);
+			if (node == NULL) {
+				built = i;
+				pending = child;
+				goto fail;
+			}
+
+			node->count = fanout - 1;
+			for (size_t j = 0; j < fanout; j++) {
+				node->children[j] = level[child + j];
+				if (j > 0)
+					node->keys[j - 1] = lows[child + j];
+			}
+			bptree_pad(node);
+
+			lows[i] = lows[child];
+			level[i] = node;
+			child += fanout;
+		}
+
+		count = parents;
+		tree->height++;
+	}
+
+	tree->root = level[0];
+	tree->size = n;
+
+	free(level);
+	free(lows);
+
+	return 0;
+
+fail:
+	// Each level is built over the front of the one below it, so level holds
+	// the finished new nodes followed by the subtrees still to be parented.
+	for (size_t i = 0; i < built; i++)
+		bptree_node_destroy(tree, level[i]);
+	for (size_t i = pending; i < count; i++)
+		bptree_node_destroy(tree, level[i]);
+	free(level);
+	free(lows);
+	bptree_clear(tree);
+
+	RETURN_ERROR;
+}
+
+int bptree_first(struct bptree *tree, struct bptree_iter *iter)
+{
+	struct bptree_node *node = tree->root;
+	if (node == NULL)
+		return -1;
+
+	while (!node->leaf)
+		node = node->children[0];
+
+	iter->leaf = node;
+	iter->index = 0;
+
+	return 0;
+}
+
+int bptree_last(struct bptree *tree, struct bptree_iter *iter)
+{
+	struct bptree_node *node = tree->root;
+	if (node == NULL)
+		return -1;
+
+	while (!node->leaf)
+		node = node->children[node->count];
+
+	iter->leaf = node;
+	iter->index = node->count - 1;
+
+	return 0;
+}
+
+int bptree_lower_bound(struct bptree *tree, uint64_t key,
+					   struct bptree_iter *iter)
+{
+	struct bptree_node *leaf = bptree_find_leaf(tree, key);
+	if (leaf == NULL)
+		return -1;
+
+	int index = bptree_rank(leaf, key);
+	if (index == leaf->count) {
+		leaf = leaf->next;
+		index = 0;
+		if (leaf == NULL)
+			return -1;
+	}
+
+	iter->leaf = leaf;
+	iter->index = index;
+
+	return 0;
+}
+
+int bptree_upper_bound(struct bptree *tree, uint64_t key,
+					   struct bptree_iter *iter)
+{
+	if (bptree_lower_bound(tree, key, iter) == -1)
+		return -1;
+	if (bptree_iter_key(iter) == key)
+		return bptree_next(iter);
+
+	return 0;
+}
+
+int bptree_next(struct bptree_iter *iter)
+{
+	if (iter->index + 1 < iter->leaf->count) {
+		iter->index++;
+		return 0;
+	}
+
+	if (iter->leaf->next == NULL)
+		return -1;
+
+	iter->leaf = iter->leaf->next;
+	iter->index = 0;
+
+	return 0;
+}
+
+int bptree_prev(struct bptree_iter *iter)
+{
+	if (iter->index > 0) {
+		iter->index--;
+		return 0;
+	}
+
+	if (iter->leaf->prev == NULL)
+		return -1;
+
+	iter->leaf = iter->leaf->prev;
+	iter->index = iter->leaf->count - 1;
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef ARIA_BPTREE_H_
+#define ARIA_BPTREE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * B+tree mapping 64-bit keys to pointers, for large ordered maps where a
+ * binary tree would take a cache miss per level. Nodes are 256 bytes: the
+ * keys fill the first two cache lines and the unused key slots hold
+ * UINT64_MAX, so the position of a key within a node is found by comparing
+ * against all 16 slots at once with vector compares instead of a branchy
+ * binary search. Values live only in the leaves, which are linked in key
+ * order for iteration.
+ *
+ * An internal node with count keys has count + 1 children; keys[i] is the
+ * smallest key that may appear under children[i + 1].
+ *
+ * alloc would put a node in its 512 byte class with only 16 byte alignment,
+ * so each tree carves its nodes out of page sized chunks instead, aligned to
+ * a cache line. Freed nodes are kept on a free list and the chunks are only
+ * released by bptree_destroy.
+ */
+#define BPTREE_KEY_SLOTS 16
+#define BPTREE_MAX_KEYS 13
+#define BPTREE_MIN_KEYS (BPTREE_MAX_KEYS / 2)
+#define BPTREE_MAX_DEPTH 24
+
+struct bptree_node {
+	uint64_t keys[BPTREE_KEY_SLOTS];
+	union {
+		struct bptree_node *children[BPTREE_MAX_KEYS + 1];
+		struct {
+			void *values[BPTREE_MAX_KEYS];
+			struct bptree_node *next;
+			struct bptree_node *prev;
+		};
+	};
+	uint16_t count;
+	uint16_t leaf;
+};
+
+static_assert(sizeof(struct bptree_node) == 256, "bptree node is 256 bytes");
+
+struct bptree_chunk {
+	struct bptree_chunk *next;
+};
+
+struct bptree {
+	struct bptree_node *root;
+	size_t size;
+	int height;
+
+	struct bptree_chunk *chunks;
+	/* Linked through children[0] */
+	struct bptree_node *free_nodes;
+};
+
+/* Position of an entry in the leaf chain */
+struct bptree_iter {
+	struct bptree_node *leaf;
+	int index;
+};
+
+void bptree_init(struct bptree *tree);
+void bptree_destroy(struct bptree *tree);
+
+/* Inserting an existing key replaces its value */
+int bptree_insert(struct bptree *tree, uint64_t key, void *value);
+int bptree_delete(struct bptree *tree, uint64_t key);
+int bptree_find(struct bptree *tree, uint64_t key, void **value);
+
+/*
+ * Build the tree from n strictly increasing keys in one pass, packing the
+ * leaves instead of splitting them one insert at a time. The tree must be
+ * empty.
+ */
+int bptree_bulk_load(struct bptree *tree, const uint64_t *keys,
+					 void *const *values, size_t n);
+
+/* These return -1 and leave iter unset when there is no such entry */
+int bptree_first(struct bptree *tree, struct bptree_iter *iter);
+int bptree_last(struct bptree *tree, struct bptree_iter *iter);
+int bptree_lower_bound(struct bptree *tree, uint64_t key,
+					   struct bptree_iter *iter);
+int bptree_upper_bound(struct bptree *tree, uint64_t key,
+					   struct bptree_iter *iter);
+int bptree_next(struct bptree_iter *iter);
+int bptree_prev(struct bptree_iter *iter);
+
+static inline uint64_t bptree_iter_key(const struct bptree_iter *iter)
+{
+	return iter->leaf->keys[iter->index];
+}
+
+static inline void *bptree_iter_value(const struct bptree_iter *iter)
+{
+	return iter->leaf->values[iter->index];
+}
+
+#endif
@@ -1,89 +1,197 @@
 #ifndef ARIA_BST_H_
 #define ARIA_BST_H_
 
-#define BST_GENERIC_INSERT(TABLE_ROOT, BASE, NODE)    \
-	({                                                \
-		int ret = 0;                                  \
-		if ((NODE) == NULL) {                         \
-			ret = -1;                                 \
-		} else {                                      \
-			(NODE)->left = NULL;                      \
-			(NODE)->right = NULL;                     \
-			__typeof__(TABLE_ROOT) root = TABLE_ROOT; \
-			__typeof__(TABLE_ROOT) parent = NULL;     \
-			for (; root;) {                           \
-				parent = root;                        \
-				if (root->BASE > (NODE)->BASE)        \
-					root = root->left;                \
-				else                                  \
-					root = root->right;               \
-			}                                         \
-			(NODE)->parent = parent;                  \
-			if (parent == NULL)                       \
-				TABLE_ROOT = (NODE);                  \
-			else if (parent->BASE > (NODE)->BASE)     \
-				parent->left = (NODE);                \
-			else                                      \
-				parent->right = (NODE);               \
-		}                                             \
-		ret;                                          \
+#define BST_GENERIC_INSERT(TABLE_ROOT, BASE, NODE)        \
+	({                                                    \
+		int _bi_ret = 0;                                  \
+		if ((NODE) == NULL) {                             \
+			_bi_ret = -1;                                 \
+		} else {                                          \
+			(NODE)->left = NULL;                          \
+			(NODE)->right = NULL;                         \
+			__typeof__(TABLE_ROOT) _bi_root = TABLE_ROOT; \
+			__typeof__(TABLE_ROOT) _bi_parent = NULL;     \
+			for (; _bi_root;) {                           \
+				_bi_parent = _bi_root;                    \
+				if (_bi_root->BASE > (NODE)->BASE)        \
+					_bi_root = _bi_root->left;            \
+				else                                      \
+					_bi_root = _bi_root->right;           \
+			}                                             \
+			(NODE)->parent = _bi_parent;                  \
+			if (_bi_parent == NULL)                       \
+				TABLE_ROOT = (NODE);                      \
+			else if (_bi_parent->BASE > (NODE)->BASE)     \
+				_bi_parent->left = (NODE);                \
+			else                                          \
+				_bi_parent->right = (NODE);               \
+		}                                                 \
+		_bi_ret;                                          \
 	})
 
-#define BST_GENERIC_DELETE(TABLE_ROOT, NODE)                          \
-	({                                                                \
-		int ret = 0;                                                  \
-		if ((NODE) == NULL) {                                         \
-			ret = -1;                                                 \
-		} else {                                                      \
-			__typeof__(NODE) parent = (NODE)->parent;                 \
-			if ((NODE)->left == NULL && (NODE)->right == NULL) {      \
-				if (parent == NULL)                                   \
-					TABLE_ROOT = NULL;                                \
-				else if (parent->left == (NODE))                      \
-					parent->left = NULL;                              \
-				else                                                  \
-					parent->right = NULL;                             \
-			} else if ((NODE)->left && (NODE)->right == NULL) {       \
-				if (parent == NULL)                                   \
-					TABLE_ROOT = (NODE)->left;                        \
-				else if (parent->left == (NODE))                      \
-					parent->left = (NODE)->left;                      \
-				else                                                  \
-					parent->right = (NODE)->left;                     \
-				(NODE)->left->parent = parent;                        \
-			} else if ((NODE)->right && (NODE)->left == NULL) {       \
-				if (parent == NULL)                                   \
-					TABLE_ROOT = (NODE)->right;                       \
-				else if (parent->left == (NODE))                      \
-					parent->left = (NODE)->right;                     \
-				else                                                  \
-					parent->right = (NODE)->right;                    \
-				(NODE)->right->parent = parent;                       \
-			} else {                                                  \
-				__typeof__(NODE) successor = (NODE)->right;           \
-				for (; successor->left;)                              \
-					successor = successor->left;                      \
-				if (successor->parent != (NODE)) {                    \
-					successor->parent->left = successor->right;       \
-					if (successor->right)                             \
-						successor->right->parent = successor->parent; \
-					successor->right = (NODE)->right;                 \
-					if (successor->right)                             \
-						successor->right->parent = successor;         \
-				}                                                     \
-				successor->left = (NODE)->left;                       \
-				if (successor->left)                                  \
-					successor->left->parent = successor;              \
-				successor->parent = parent;                           \
-				if (parent == NULL)                                   \
-					TABLE_ROOT = successor;                           \
-				else if (parent->left == (NODE))                      \
-					parent->left = successor;                         \
-				else                                                  \
-					parent->right = successor;                        \
-			}                                                         \
-		}                                                             \
-		ret;                                                          \
+#define BST_GENERIC_DELETE(TABLE_ROOT, NODE)                                  \
+	({                                                                        \
+		int _bd_ret = 0;                                                      \
+		if ((NODE) == NULL) {                                                 \
+			_bd_ret = -1;                                                     \
+		} else {                                                              \
+			__typeof__(NODE) _bd_parent = (NODE)->parent;                     \
+			if ((NODE)->left == NULL && (NODE)->right == NULL) {              \
+				if (_bd_parent == NULL)                                       \
+					TABLE_ROOT = NULL;                                        \
+				else if (_bd_parent->left == (NODE))                          \
+					_bd_parent->left = NULL;                                  \
+				else                                                          \
+					_bd_parent->right = NULL;                                 \
+			} else if ((NODE)->left && (NODE)->right == NULL) {               \
+				if (_bd_parent == NULL)                                       \
+					TABLE_ROOT = (NODE)->left;                                \
+				else if (_bd_parent->left == (NODE))                          \
+					_bd_parent->left = (NODE)->left;                          \
+				else                                                          \
+					_bd_parent->right = (NODE)->left;                         \
+				(NODE)->left->parent = _bd_parent;                            \
+			} else if ((NODE)->right && (NODE)->left == NULL) {               \
+				if (_bd_parent == NULL)                                       \
+					TABLE_ROOT = (NODE)->right;                               \
+				else if (_bd_parent->left == (NODE))                          \
+					_bd_parent->left = (NODE)->right;                         \
+				else                                                          \
+					_bd_parent->right = (NODE)->right;                        \
+				(NODE)->right->parent = _bd_parent;                           \
+			} else {                                                          \
+				__typeof__(NODE) _bd_successor = (NODE)->right;               \
+				for (; _bd_successor->left;)                                  \
+					_bd_successor = _bd_successor->left;                      \
+				if (_bd_successor->parent != (NODE)) {                        \
+					_bd_successor->parent->left = _bd_successor->right;       \
+					if (_bd_successor->right)                                 \
+						_bd_successor->right->parent = _bd_successor->parent; \
+					_bd_successor->right = (NODE)->right;                     \
+					if (_bd_successor->right)                                 \
+						_bd_successor->right->parent = _bd_successor;         \
+				}                                                             \
+				_bd_successor->left = (NODE)->left;                           \
+				if (_bd_successor->left)                                      \
+					_bd_successor->left->parent = _bd_successor;              \
+				_bd_successor->parent = _bd_parent;                           \
+				if (_bd_parent == NULL)                                       \
+					TABLE_ROOT = _bd_successor;                               \
+				else if (_bd_parent->left == (NODE))                          \
+					_bd_parent->left = _bd_successor;                         \
+				else                                                          \
+					_bd_parent->right = _bd_successor;                        \
+			}                                                                 \
+		}                                                                     \
+		_bd_ret;                                                              \
 	})
 
+/*
+ * Ordered lookups over any tree with left/right/parent links, keyed on the
+ * BASE member. Equal keys are inserted to the right, so they are visited in
+ * insertion order.
+ */
+#define BST_FIND(TABLE_ROOT, BASE, KEY)                              \
+	({                                                               \
+		__typeof__(TABLE_ROOT) _bf_node = TABLE_ROOT;                \
+		__typeof__(_bf_node->BASE) _bf_key = (KEY);                  \
+		while (_bf_node && _bf_node->BASE != _bf_key)                \
+			_bf_node = (_bf_node->BASE > _bf_key) ? _bf_node->left : \
+													_bf_node->right; \
+		_bf_node;                                                    \
+	})
+
+// First node whose key is not below KEY.
+#define BST_LOWER_BOUND(TABLE_ROOT, BASE, KEY)         \
+	({                                                 \
+		__typeof__(TABLE_ROOT) _blb_node = TABLE_ROOT; \
+		__typeof__(TABLE_ROOT) _blb_ret = NULL;        \
+		__typeof__(_blb_node->BASE) _blb_key = (KEY);  \
+		while (_blb_node) {                            \
+			if (_blb_node->BASE >= _blb_key) {         \
+				_blb_ret = _blb_node;                  \
+				_blb_node = _blb_node->left;           \
+			} else {                                   \
+				_blb_node = _blb_node->right;          \
+			}                                          \
+		}                                              \
+		_blb_ret;                                      \
+	})
+
+// First node whose key is above KEY.
+#define BST_UPPER_BOUND(TABLE_ROOT, BASE, KEY)         \
+	({                                                 \
+		__typeof__(TABLE_ROOT) _bub_node = TABLE_ROOT; \
+		__typeof__(TABLE_ROOT) _bub_ret = NULL;        \
+		__typeof__(_bub_node->BASE) _bub_key = (KEY);  \
+		while (_bub_node) {                            \
+			if (_bub_node->BASE > _bub_key) {          \
+				_bub_ret = _bub_node;                  \
+				_bub_node = _bub_node->left;           \
+			} else {                                   \
+				_bub_node = _bub_node->right;          \
+			}                                          \
+		}                                              \
+		_bub_ret;                                      \
+	})
+
+#define BST_FIRST(TABLE_ROOT)                          \
+	({                                                 \
+		__typeof__(TABLE_ROOT) _bfi_node = TABLE_ROOT; \
+		while (_bfi_node && _bfi_node->left)           \
+			_bfi_node = _bfi_node->left;               \
+		_bfi_node;                                     \
+	})
+
+#define BST_LAST(TABLE_ROOT)                           \
+	({                                                 \
+		__typeof__(TABLE_ROOT) _bla_node = TABLE_ROOT; \
+		while (_bla_node && _bla_node->right)          \
+			_bla_node = _bla_node->right;              \
+		_bla_node;                                     \
+	})
+
+#define BST_NEXT(NODE)                                          \
+	({                                                          \
+		__typeof__(NODE) _bn_node = (NODE);                     \
+		if (_bn_node->right) {                                  \
+			_bn_node = _bn_node->right;                         \
+			while (_bn_node->left)                              \
+				_bn_node = _bn_node->left;                      \
+		} else {                                                \
+			__typeof__(NODE) _bn_child;                         \
+			do {                                                \
+				_bn_child = _bn_node;                           \
+				_bn_node = _bn_node->parent;                    \
+			} while (_bn_node && _bn_node->right == _bn_child); \
+		}                                                       \
+		_bn_node;                                               \
+	})
+
+#define BST_PREV(NODE)                                         \
+	({                                                         \
+		__typeof__(NODE) _bp_node = (NODE);                    \
+		if (_bp_node->left) {                                  \
+			_bp_node = _bp_node->left;                         \
+			while (_bp_node->right)                            \
+				_bp_node = _bp_node->right;                    \
+		} else {                                               \
+			__typeof__(NODE) _bp_child;                        \
+			do {                                               \
+				_bp_child = _bp_node;                          \
+				_bp_node = _bp_node->parent;                   \
+			} while (_bp_node && _bp_node->left == _bp_child); \
+		}                                                      \
+		_bp_node;                                              \
+	})
+
+// In-order iteration. NODE must not be removed from the tree inside the loop.
+#define BST_FOREACH(NODE, TABLE_ROOT)                                     \
+	for ((NODE) = BST_FIRST(TABLE_ROOT); (NODE); (NODE) = BST_NEXT(NODE))
+
+// In-order iteration over the nodes with LOW <= key < HIGH.
+#define BST_FOREACH_RANGE(NODE, TABLE_ROOT, BASE, LOW, HIGH)       \
+	for ((NODE) = BST_LOWER_BOUND(TABLE_ROOT, BASE, LOW);          \
+		 (NODE) && (NODE)->BASE < (HIGH); (NODE) = BST_NEXT(NODE))
+
 #endif
@@ -2,6 +2,7 @@
 #include <aria/string.h>
 #include <aria/slab.h>
 #include <aria/debug.h>
+#include <aria/sched.h>
 
 int circular_queue_init(struct circular_queue *queue, int data_offset,
 						size_t size, size_t obj_size)
@@ -14,6 +15,9 @@ int circular_queue_init(struct circular_queue *queue, int data_offset,
 	queue->head = -1;
 	queue->tail = -1;
 	queue->items = 0;
+	queue->futex = 0;
+	queue->waiters = 0;
+	queue->threshold = 0;
 	return 0;
 }
 
@@ -37,7 +41,8 @@ int circular_queue_push(struct circular_queue *queue, const void *data)
 
 	memcpy((void *)queue + queue->data_offset + (queue->tail * queue->obj_size),
 		   data, queue->obj_size);
-	__atomic_add_fetch(&queue->items, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&queue->items, 1, __ATOMIC_SEQ_CST);
+	circular_queue_notify(queue);
 
 	return true;
 }
@@ -100,6 +105,151 @@ int circular_queue_peek(struct circular_queue *queue, void *data)
 	return true;
 }
 
+static inline void *circular_queue_slot(struct circular_queue *queue,
+										int index)
+{
+	return (void *)queue + queue->data_offset + (index * queue->obj_size);
+}
+
+static inline int circular_queue_count(struct circular_queue *queue)
+{
+	if (queue->head == -1)
+		return 0;
+	if (queue->tail >= queue->head)
+		return queue->tail - queue->head + 1;
+	return queue->size - queue->head + queue->tail + 1;
+}
+
+int circular_queue_push_n(struct circular_queue *queue, const void *data,
+						  size_t n)
+{
+	if (queue == NULL || data == NULL)
+		RETURN_ERROR;
+
+	int count = circular_queue_count(queue);
+	if (n > (size_t)(queue->size - count))
+		n = queue->size - count;
+	if (n == 0)
+		return 0;
+
+	int start = (queue->head == -1) ? 0 : (queue->tail + 1) % queue->size;
+	int first = queue->size - start;
+	if ((size_t)first > n)
+		first = n;
+
+	memcpy(circular_queue_slot(queue, start), data, first * queue->obj_size);
+	if ((size_t)first < n)
+		memcpy(circular_queue_slot(queue, 0), data + first * queue->obj_size,
+			   (n - first) * queue->obj_size);
+
+	if (queue->head == -1)
+		queue->head = 0;
+	queue->tail = (start + n - 1) % queue->size;
+	__atomic_add_fetch(&queue->items, n, __ATOMIC_SEQ_CST);
+	circular_queue_notify(queue);
+
+	return n;
+}
+
+int circular_queue_pop_n(struct circular_queue *queue, void *data, size_t n)
+{
+	if (queue == NULL || data == NULL)
+		RETURN_ERROR;
+
+	int count = circular_queue_count(queue);
+	if (n > (size_t)count)
+		n = count;
+	if (n == 0)
+		return 0;
+
+	int first = queue->size - queue->head;
+	if ((size_t)first > n)
+		first = n;
+
+	memcpy(data, circular_queue_slot(queue, queue->head),
+		   first * queue->obj_size);
+	if ((size_t)first < n)
+		memcpy(data + first * queue->obj_size, circular_queue_slot(queue, 0),
+			   (n - first) * queue->obj_size);
+
+	return circular_queue_consume(queue, n);
+}
+
+int circular_queue_peek_span(struct circular_queue *queue, void **span)
+{
+	if (queue == NULL || span == NULL)
+		RETURN_ERROR;
+	if (queue->head == -1) {
+		*span = NULL;
+		return 0;
+	}
+
+	*span = circular_queue_slot(queue, queue->head);
+
+	if (queue->tail >= queue->head)
+		return queue->tail - queue->head + 1;
+	return queue->size - queue->head;
+}
+
+int circular_queue_consume(struct circular_queue *queue, size_t n)
+{
+	if (queue == NULL)
+		RETURN_ERROR;
+
+	int count = circular_queue_count(queue);
+	if (n > (size_t)count)
+		n = count;
+	if (n == 0)
+		return 0;
+
+	if (n == (size_t)count) {
+		queue->head = -1;
+		queue->tail = -1;
+	} else {
+		queue->head = (queue->head + n) % queue->size;
+	}
+	__atomic_sub_fetch(&queue->items, n, __ATOMIC_RELAXED);
+
+	return n;
+}
+
+int circular_queue_wait(struct circular_queue *queue, size_t threshold)
+{
+	if (queue == NULL || threshold == 0 || threshold > (size_t)queue->size)
+		RETURN_ERROR;
+
+	for (;;) {
+		if (__atomic_load_n(&queue->items, __ATOMIC_SEQ_CST) >= threshold)
+			return 0;
+
+		// Register before sampling the futex word and re-checking items so
+		// that a producer either sees us as a waiter or we see its push.
+		__atomic_store_n(&queue->threshold, threshold, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+		uint32_t futex = __atomic_load_n(&queue->futex, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&queue->items, __ATOMIC_SEQ_CST) < threshold)
+			futex_wait(&queue->futex, futex);
+
+		__atomic_sub_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+int circular_queue_notify(struct circular_queue *queue)
+{
+	if (queue == NULL)
+		RETURN_ERROR;
+	if (__atomic_load_n(&queue->waiters, __ATOMIC_SEQ_CST) == 0)
+		return 0;
+	if (__atomic_load_n(&queue->items, __ATOMIC_SEQ_CST) <
+		__atomic_load_n(&queue->threshold, __ATOMIC_RELAXED))
+		return 0;
+
+	__atomic_add_fetch(&queue->futex, 1, __ATOMIC_SEQ_CST);
+
+	return futex_wake(&queue->futex, INT32_MAX);
+}
+
 int circular_queue_remove(struct circular_queue *queue, const void *data)
 {
 	if (queue == NULL || data == NULL)
@@ -14,9 +14,18 @@ struct circular_queue {
 
 	// This is the only atomic field. However, do not treat
 	// this datastructure as a atomic. The rationale for this
-	// is to allow polling for the items available in a thread
-	// safe manner.
+	// is to allow checking for the items available in a thread
+	// safe manner. Consumers that want to sleep rather than
+	// poll should use circular_queue_wait.
 	size_t items;
+
+	// Sleeping consumer state. The futex word is bumped by a
+	// producer before it wakes the sleeper, and producers only
+	// enter the kernel once waiters is non-zero and threshold
+	// items are available.
+	uint32_t futex;
+	uint32_t waiters;
+	size_t threshold;
 };
 
 int circular_queue_init(struct circular_queue *queue, int data_offset,
@@ -29,4 +38,29 @@ int circular_queue_pop_tail(struct circular_queue *queue, void *data);
 int circular_queue_peek(struct circular_queue *queue, void *data);
 int circular_queue_remove(struct circular_queue *queue, const void *data);
 
+/*
+ * Batched variants. These move up to n elements with at most two contiguous
+ * copies and a single index/counter update, returning the number of elements
+ * that were actually moved.
+ */
+int circular_queue_push_n(struct circular_queue *queue, const void *data,
+						  size_t n);
+int circular_queue_pop_n(struct circular_queue *queue, void *data, size_t n);
+
+/*
+ * Zero-copy consumption. peek_span returns the number of elements that are
+ * stored contiguously from the head and points span at the first one; the
+ * elements stay in the queue until they are released with consume.
+ */
+int circular_queue_peek_span(struct circular_queue *queue, void **span);
+int circular_queue_consume(struct circular_queue *queue, size_t n);
+
+/*
+ * Block the (single) consumer until at least threshold items are available.
+ * Producers call circular_queue_notify from push, which only issues a futex
+ * wake when a consumer is registered as sleeping.
+ */
+int circular_queue_wait(struct circular_queue *queue, size_t threshold);
+int circular_queue_notify(struct circular_queue *queue);
+
 #endif
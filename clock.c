@@ -0,0 +1,137 @@
+#include <aria/clock.h>
+#include <aria/address.h>
+#include <aria/portal.h>
+#include <aria/syscall.h>
+#include <aria/string.h>
+#include <aria/debug.h>
+
+static struct clock_page *clock_page;
+
+static int clock_page_map(int prot, int create)
+{
+	uintptr_t address;
+	if (as_vmem_allocate(CAPABILITY_SELF_AS, &address, PAGE_SIZE) == -1)
+		RETURN_ERROR;
+
+	struct portal_req portal_req = {
+		.type = PORTAL_REQ_SHARE,
+		.prot = prot,
+		.length = sizeof(struct portal_req),
+		.share = { .identifier = CLOCK_PAGE_IDENTIFIER,
+				   .create = create,
+				   .length = PAGE_SIZE,
+				   .type = 0 },
+		.morphology = { .addr = address, .length = PAGE_SIZE }
+	};
+
+	struct portal_resp portal_resp;
+
+	struct syscall_response syscall_response =
+		SYSCALL2(SYSCALL_PORTAL, &portal_req, &portal_resp);
+	if (syscall_response.ret == -1 || portal_resp.base != address ||
+		portal_resp.limit != PAGE_SIZE)
+		RETURN_ERROR;
+
+	clock_page = (struct clock_page *)address;
+
+	return 0;
+}
+
+int clock_map(void)
+{
+	return clock_page_map(PORTAL_PROT_READ, 0);
+}
+
+int clock_page_create(struct clock_page **page)
+{
+	if (page == NULL)
+		RETURN_ERROR;
+
+	if (clock_page_map(PORTAL_PROT_READ | PORTAL_PROT_WRITE, 1) == -1)
+		RETURN_ERROR;
+
+	*page = clock_page;
+
+	return 0;
+}
+
+int clock_page_update(struct clock_page *page, struct timer *timer,
+					  uint64_t base, struct time realtime)
+{
+	if (page == NULL || timer == NULL)
+		return -1;
+
+	if (timer->mult == 0 &&
+		timer_calibrate(timer, timer->freq, timer->base) == -1)
+		return -1;
+
+	struct time monotonic = { .sec = 0, .nsec = 0 };
+	if (page->mult) {
+		struct timer previous = { .mult = page->mult,
+								  .shift = page->shift,
+								  .base = page->base };
+		monotonic = time_add(page->monotonic, time_convert(&previous, base));
+	}
+
+	uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	page->source = timer->source;
+	page->freq = timer->freq;
+	page->mult = timer->mult;
+	page->shift = timer->shift;
+	page->base = base;
+	page->monotonic = monotonic;
+	page->realtime = realtime;
+
+	__atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int clock_gettime(int clock, struct time *ret)
+{
+	if (clock_page == NULL || ret == NULL)
+		return -1;
+
+	struct clock_page snapshot;
+	uint32_t sequence;
+	uint64_t counter;
+
+	for (;;) {
+		sequence = __atomic_load_n(&clock_page->sequence, __ATOMIC_ACQUIRE);
+		if (sequence & 1) {
+			__builtin_ia32_pause();
+			continue;
+		}
+
+		memcpy(&snapshot, clock_page, sizeof(snapshot));
+		counter = tsc_read();
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&clock_page->sequence, __ATOMIC_RELAXED) ==
+			sequence)
+			break;
+	}
+
+	if (snapshot.mult == 0)
+		return -1;
+
+	struct timer timer = { .source = snapshot.source,
+						   .freq = snapshot.freq,
+						   .mult = snapshot.mult,
+						   .shift = snapshot.shift,
+						   .base = snapshot.base };
+
+	struct time elapsed = time_convert(&timer, counter);
+
+	if (clock == CLOCK_MONOTONIC)
+		*ret = time_add(snapshot.monotonic, elapsed);
+	else if (clock == CLOCK_REALTIME)
+		*ret = time_add(snapshot.realtime, elapsed);
+	else
+		return -1;
+
+	return 0;
+}
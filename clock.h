@@ -0,0 +1,56 @@
+#ifndef ARIA_CLOCK_H_
+#define ARIA_CLOCK_H_
+
+#include <aria/time.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+constexpr int CLOCK_MONOTONIC = 0;
+constexpr int CLOCK_REALTIME = 1;
+
+#define CLOCK_PAGE_IDENTIFIER "clock"
+
+/*
+ * Calibration shared by every process through a single page, written by the
+ * time service and mapped read-only everywhere else. Readers convert the
+ * counter themselves with the same mult/shift as struct timer, so reading
+ * the clock needs no syscall and all processes agree on the time.
+ *
+ * The page is published with a sequence counter: the writer makes it odd
+ * before touching the fields and even again afterwards, and a reader retries
+ * until it copied the fields between two reads of the same even value.
+ */
+struct clock_page {
+	uint32_t sequence;
+	int source;
+	freq_t freq;
+	uint64_t mult;
+	uint32_t shift;
+	/* Counter value at which the monotonic clock read monotonic */
+	uint64_t base;
+	struct time monotonic;
+	/* Wall time at the same instant */
+	struct time realtime;
+};
+
+/* Map the page published by the time service */
+int clock_map(void);
+
+/*
+ * Create and map the page writable, for the time service. The page is
+ * also used by clock_gettime in the calling process.
+ */
+int clock_page_create(struct clock_page **page);
+
+/*
+ * Publish a new calibration. The monotonic clock continues from where it
+ * was at counter value base, so recalibrating never makes it go back.
+ * realtime is the wall time at base.
+ */
+int clock_page_update(struct clock_page *page, struct timer *timer,
+					  uint64_t base, struct time realtime);
+
+int clock_gettime(int clock, struct time *ret);
+
+#endif
@@ -0,0 +1,98 @@
+#include <aria/concurrent_dictionary.h>
+#include <aria/hash.h>
+#include <aria/debug.h>
+
+static inline struct concurrent_dictionary_shard *
+concurrent_dictionary_shard(struct concurrent_dictionary *dictionary,
+							uint64_t hash)
+{
+	return &dictionary->shards[hash >> (64 - CONCURRENT_DICTIONARY_SHARD_BITS)];
+}
+
+int concurrent_dictionary_init(struct concurrent_dictionary *dictionary)
+{
+	if (dictionary == NULL)
+		RETURN_ERROR;
+
+	dictionary->seed = hash_seed() ^ (uintptr_t)dictionary;
+	if (dictionary->seed == 0)
+		dictionary->seed = 1;
+
+	for (int i = 0; i < CONCURRENT_DICTIONARY_SHARDS; i++) {
+		dictionary->shards[i] = (struct concurrent_dictionary_shard){
+			.dictionary = { .seed = dictionary->seed }
+		};
+	}
+
+	return 0;
+}
+
+int concurrent_dictionary_push(struct concurrent_dictionary *dictionary,
+							   void *key, void *data, size_t key_size)
+{
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+
+	uint64_t hash = hash_bytes(key, key_size, dictionary->seed);
+	struct concurrent_dictionary_shard *shard =
+		concurrent_dictionary_shard(dictionary, hash);
+
+	rwlock_write(&shard->lock);
+	int ret = dictionary_push_hashed(&shard->dictionary, key, data, key_size,
+									 hash);
+	rwlock_write_release(&shard->lock);
+
+	return ret;
+}
+
+int concurrent_dictionary_delete(struct concurrent_dictionary *dictionary,
+								 void *key, size_t key_size)
+{
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+
+	uint64_t hash = hash_bytes(key, key_size, dictionary->seed);
+	struct concurrent_dictionary_shard *shard =
+		concurrent_dictionary_shard(dictionary, hash);
+
+	rwlock_write(&shard->lock);
+	int ret =
+		dictionary_delete_hashed(&shard->dictionary, key, key_size, hash);
+	rwlock_write_release(&shard->lock);
+
+	return ret;
+}
+
+int concurrent_dictionary_search(struct concurrent_dictionary *dictionary,
+								 void *key, size_t key_size, void **ret)
+{
+	if (dictionary == NULL || key == NULL || ret == NULL)
+		RETURN_ERROR;
+
+	uint64_t hash = hash_bytes(key, key_size, dictionary->seed);
+	struct concurrent_dictionary_shard *shard =
+		concurrent_dictionary_shard(dictionary, hash);
+
+	rwlock_read(&shard->lock);
+	int status = dictionary_lookup_hashed(&shard->dictionary, key, key_size,
+										  hash, ret);
+	rwlock_read_release(&shard->lock);
+
+	return status;
+}
+
+int concurrent_dictionary_destroy(struct concurrent_dictionary *dictionary)
+{
+	if (dictionary == NULL)
+		RETURN_ERROR;
+
+	for (int i = 0; i < CONCURRENT_DICTIONARY_SHARDS; i++) {
+		struct concurrent_dictionary_shard *shard = &dictionary->shards[i];
+
+		rwlock_write(&shard->lock);
+		dictionary_destroy(&shard->dictionary);
+		rwlock_write_release(&shard->lock);
+	}
+
+	return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef ARIA_CONCURRENT_DICTIONARY_H_
+#define ARIA_CONCURRENT_DICTIONARY_H_
+
+#include <aria/dictionary.h>
+#include <aria/lock.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Thread-safe dictionary split into independently locked shards. A key's
+ * shard is picked from the top bits of its hash, which the shard dictionaries
+ * do not use for probing, and all shards share one seed so the hash is only
+ * computed once. Lookups take the shard's lock for reading and never modify
+ * the shard, while pushes and deletes take it for writing. Each shard
+ * resizes incrementally on its own.
+ */
+#define CONCURRENT_DICTIONARY_SHARD_BITS 6
+#define CONCURRENT_DICTIONARY_SHARDS (1 << CONCURRENT_DICTIONARY_SHARD_BITS)
+
+struct concurrent_dictionary_shard {
+	alignas(64) struct rwlock lock;
+	struct dictionary dictionary;
+};
+
+struct concurrent_dictionary {
+	uint64_t seed;
+	struct concurrent_dictionary_shard shards[CONCURRENT_DICTIONARY_SHARDS];
+};
+
+int concurrent_dictionary_init(struct concurrent_dictionary *);
+int concurrent_dictionary_push(struct concurrent_dictionary *, void *, void *,
+							   size_t);
+int concurrent_dictionary_delete(struct concurrent_dictionary *, void *,
+								 size_t);
+int concurrent_dictionary_search(struct concurrent_dictionary *, void *,
+								 size_t, void **);
+int concurrent_dictionary_destroy(struct concurrent_dictionary *);
+
+#endif
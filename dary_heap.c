@@ -0,0 +1,152 @@
+#include <aria/dary_heap.h>
+
+static inline void place(struct dary_heap *heap, size_t index, void *element)
+{
+	VECTOR_DATA(heap->data)[index] = element;
+
+	if (heap->set_index) {
+		heap->set_index(element, index);
+	}
+}
+
+/* Move element up from the hole at index until its parent is not worse */
+static void sift_up(struct dary_heap *heap, size_t index, void *element)
+{
+	void **data = VECTOR_DATA(heap->data);
+
+	while (index > 0) {
+		size_t parent = (index - 1) / DARY_HEAP_ARITY;
+
+		if (!heap->cmp(element, data[parent])) {
+			break;
+		}
+
+		place(heap, index, data[parent]);
+		index = parent;
+	}
+
+	place(heap, index, element);
+}
+
+/* Move element down from the hole at index, swapping with the best child */
+static void sift_down(struct dary_heap *heap, size_t index, void *element)
+{
+	void **data = VECTOR_DATA(heap->data);
+	size_t size = heap->data.length;
+
+	for (;;) {
+		size_t first = index * DARY_HEAP_ARITY + 1;
+		if (first >= size) {
+			break;
+		}
+
+		size_t last = first + DARY_HEAP_ARITY;
+		if (last > size) {
+			last = size;
+		}
+
+		size_t best = first;
+		for (size_t child = first + 1; child < last; child++) {
+			if (heap->cmp(data[child], data[best])) {
+				best = child;
+			}
+		}
+
+		if (!heap->cmp(data[best], element)) {
+			break;
+		}
+
+		place(heap, index, data[best]);
+		index = best;
+	}
+
+	place(heap, index, element);
+}
+
+void dary_heap_init(struct dary_heap *heap, dary_heap_cmp_func *cmp,
+					dary_heap_index_func *set_index)
+{
+	heap->data = (__typeof__(heap->data)){ 0 };
+	heap->cmp = cmp;
+	heap->set_index = set_index;
+}
+
+void dary_heap_destroy(struct dary_heap *heap)
+{
+	VECTOR_CLEAR(heap->data);
+}
+
+int dary_heap_reserve(struct dary_heap *heap, size_t capacity)
+{
+	return VECTOR_RESERVE(heap->data, capacity);
+}
+
+int dary_heap_insert(struct dary_heap *heap, void *element)
+{
+	if (VECTOR_PUSH(heap->data, element) == -1) {
+		return -1;
+	}
+
+	sift_up(heap, heap->data.length - 1, element);
+
+	return 0;
+}
+
+void *dary_heap_top(struct dary_heap *heap)
+{
+	if (heap->data.length == 0) {
+		return NULL;
+	}
+
+	return VECTOR_DATA(heap->data)[0];
+}
+
+void *dary_heap_remove(struct dary_heap *heap, size_t index)
+{
+	if (index >= heap->data.length) {
+		return NULL;
+	}
+
+	void **data = VECTOR_DATA(heap->data);
+	void *element = data[index];
+	void *last = data[--heap->data.length];
+
+	if (index < heap->data.length) {
+		/* The last element may belong above or below the hole */
+		if (index > 0 && heap->cmp(last, data[(index - 1) / DARY_HEAP_ARITY])) {
+			sift_up(heap, index, last);
+		} else {
+			sift_down(heap, index, last);
+		}
+	}
+
+	return element;
+}
+
+void *dary_heap_pop(struct dary_heap *heap)
+{
+	return dary_heap_remove(heap, 0);
+}
+
+int dary_heap_update(struct dary_heap *heap, size_t index)
+{
+	if (index >= heap->data.length) {
+		return -1;
+	}
+
+	void **data = VECTOR_DATA(heap->data);
+	void *element = data[index];
+
+	if (index > 0 && heap->cmp(element, data[(index - 1) / DARY_HEAP_ARITY])) {
+		sift_up(heap, index, element);
+	} else {
+		sift_down(heap, index, element);
+	}
+
+	return 0;
+}
+
+size_t dary_heap_size(const struct dary_heap *heap)
+{
+	return heap->data.length;
+}
@@ -0,0 +1,58 @@
+#ifndef ARIA_DARY_HEAP_
+#define ARIA_DARY_HEAP_
+#include <aria/vector.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Implicit d-ary heap of pointers in one contiguous array. Compared to the
+ * pairing heap a pop only touches a few cache lines: the children of slot i
+ * are the DARY_HEAP_ARITY adjacent slots starting at DARY_HEAP_ARITY * i + 1.
+ */
+#define DARY_HEAP_ARITY 4
+
+/*
+ * Same contract as pairing_heap_cmp_func:
+ * returning a < b will result in a min heap
+ * returning a > b will result in a max heap
+ */
+typedef bool dary_heap_cmp_func(void *a, void *b);
+
+/*
+ * Optional callback, told the new slot of an element every time it moves.
+ * Storing that slot in the element allows dary_heap_remove and
+ * dary_heap_update on arbitrary elements in O(log n).
+ */
+typedef void dary_heap_index_func(void *element, size_t index);
+
+struct dary_heap {
+	VECTOR(void *) data;
+	dary_heap_cmp_func *cmp;
+	dary_heap_index_func *set_index;
+};
+
+void dary_heap_init(struct dary_heap *heap, dary_heap_cmp_func *cmp,
+					dary_heap_index_func *set_index);
+void dary_heap_destroy(struct dary_heap *heap);
+
+int dary_heap_reserve(struct dary_heap *heap, size_t capacity);
+
+int dary_heap_insert(struct dary_heap *heap, void *element);
+
+/* Get whatever is at the top of the heap and removes it */
+void *dary_heap_pop(struct dary_heap *heap);
+
+/* Get whatever is at the top of the heap without removing it */
+void *dary_heap_top(struct dary_heap *heap);
+
+/* Remove the element at index, as reported through set_index */
+void *dary_heap_remove(struct dary_heap *heap, size_t index);
+
+/* Restore the heap after the key of the element at index changed */
+int dary_heap_update(struct dary_heap *heap, size_t index);
+
+size_t dary_heap_size(const struct dary_heap *heap);
+
+#endif
@@ -1,121 +1,373 @@
 #include <aria/slab.h>
 #include <aria/string.h>
+#include <aria/hash.h>
+#include <aria/compiler.h>
 #include <aria/dictionary.h>
 #include <aria/debug.h>
 
-static uint64_t fnv_hash(char *data, size_t byte_cnt)
+#define DICTIONARY_MIN_CAPACITY 16
+#define DICTIONARY_MIGRATE_GROUPS 2
+#define DICTIONARY_NOT_FOUND SIZE_MAX
+#define DICTIONARY_BATCH 16
+
+uint64_t dictionary_hash(struct dictionary *dictionary, void *key,
+						 size_t key_size)
 {
-	uint64_t hash = 0xcbf29ce484222325;
+	if (dictionary->seed == 0)
+		dictionary->seed = hash_seed() ^ (uintptr_t)dictionary;
 
-	for (size_t i = 0; i < byte_cnt; i++) {
-		hash ^= *(data + i);
-		hash *= 0x100000001b3;
-	}
+	return hash_bytes(key, key_size, dictionary->seed);
+}
 
-	return hash;
+static inline bool table_full(struct dictionary_table *table,
+							  size_t additional)
+{
+	return (table->element_cnt + table->tombstone_cnt + additional) * 8 >
+		   table->capacity * 7;
 }
 
-int dictionary_search(struct dictionary *table, void *key, size_t key_size,
-					  void **ret)
+static size_t table_find(struct dictionary_table *table, void *key,
+						 size_t key_size, uint64_t hash)
 {
-	if (table == NULL || key == NULL || ret == NULL)
-		RETURN_ERROR;
 	if (table->capacity == 0)
-		return 0;
+		return DICTIONARY_NOT_FOUND;
+
+	size_t mask = table->capacity / HASH_GROUP_WIDTH - 1;
+	size_t group = HASH_GROUP(hash) & mask;
+	uint8_t tag = HASH_TAG(hash);
 
-	uint64_t hash = fnv_hash(key, key_size);
-	size_t index = hash & (table->capacity - 1);
+	for (size_t probe = 1; probe <= mask + 1; probe++) {
+		uint8_t *control = table->control + group * HASH_GROUP_WIDTH;
 
-	for (; index < table->capacity; index++) {
-		if (table->keys[index] != NULL &&
-			memcmp(table->keys[index], key, key_size) == 0) {
-			*ret = table->data[index];
-			return 0;
+		for (uint32_t match = hash_group_match(control, tag); match;
+			 match &= match - 1) {
+			size_t index = group * HASH_GROUP_WIDTH + __builtin_ctz(match);
+			struct dictionary_slot *slot = &table->slots[index];
+
+			if (slot->hash == hash && slot->key_size == key_size &&
+				memcmp(slot->key, key, key_size) == 0)
+				return index;
 		}
+
+		if (hash_group_match_empty(control))
+			break;
+
+		group = (group + probe) & mask;
 	}
 
-	return -1;
+	return DICTIONARY_NOT_FOUND;
 }
 
-int dictionary_push(struct dictionary *table, void *key, void *data,
-					size_t key_size)
+// Pull in the first group hash probes, both its control bytes and the slots
+// whose hashes are compared against, ahead of the actual lookup.
+static inline void table_prefetch(struct dictionary_table *table,
+								  uint64_t hash)
+{
+	if (table->capacity == 0)
+		return;
+
+	size_t mask = table->capacity / HASH_GROUP_WIDTH - 1;
+	size_t index = (HASH_GROUP(hash) & mask) * HASH_GROUP_WIDTH;
+
+	__builtin_prefetch(table->control + index);
+	__builtin_prefetch(table->slots + index);
+}
+
+static void table_insert(struct dictionary_table *table,
+						 struct dictionary_slot *slot)
+{
+	size_t index = hash_find_free(table->control, table->capacity, slot->hash);
+	if (table->control[index] == HASH_CTRL_DELETED)
+		table->tombstone_cnt--;
+
+	table->control[index] = HASH_TAG(slot->hash);
+	table->slots[index] = *slot;
+	table->element_cnt++;
+}
+
+static void table_erase(struct dictionary_table *table, size_t index)
 {
-	if (table == NULL || key == NULL)
+	table->slots[index] = (struct dictionary_slot){ 0 };
+	table->element_cnt--;
+
+	// Probes stop at the first group that has an empty slot, so a slot in
+	// such a group can become empty again without breaking any chain.
+	uint8_t *group = table->control + (index & ~(HASH_GROUP_WIDTH - 1));
+	if (hash_group_match_empty(group)) {
+		table->control[index] = HASH_CTRL_EMPTY;
+	} else {
+		table->control[index] = HASH_CTRL_DELETED;
+		table->tombstone_cnt++;
+	}
+}
+
+static int table_create(struct dictionary_table *table, size_t capacity)
+{
+	*table = (struct dictionary_table){ .capacity = capacity };
+
+	table->control = alloc(capacity);
+	if (table->control == NULL)
+		RETURN_ERROR;
+
+	table->slots = alloc(capacity * sizeof(struct dictionary_slot));
+	if (table->slots == NULL) {
+		free(table->control);
 		RETURN_ERROR;
-	if (table->capacity == 0) {
-		table->capacity = 16;
+	}
 
-		table->data = alloc(table->capacity * sizeof(void *));
-		if (table->data == NULL)
-			RETURN_ERROR;
+	// alloc hands out zeroed objects, which is an all-empty control array.
+	return 0;
+}
 
-		table->keys = alloc(table->capacity * sizeof(void *));
-		if (table->keys == NULL)
-			RETURN_ERROR;
+static void table_destroy(struct dictionary_table *table)
+{
+	for (size_t i = 0; i < table->capacity; i++) {
+		if (table->control[i] & HASH_CTRL_FULL)
+			free(table->slots[i].key);
 	}
 
-	uint64_t hash = fnv_hash(key, key_size);
-	size_t index = hash & (table->capacity - 1);
+	free(table->control);
+	free(table->slots);
+
+	*table = (struct dictionary_table){ 0 };
+}
+
+// Move up to groups groups of the previous table into the current one and
+// release the previous table once it has been drained.
+static void dictionary_migrate(struct dictionary *dictionary, size_t groups)
+{
+	struct dictionary_table *previous = &dictionary->previous;
+	if (likely(previous->capacity == 0))
+		return;
+
+	size_t end = previous->capacity / HASH_GROUP_WIDTH;
+	if (groups < end - dictionary->migrate_cursor)
+		end = dictionary->migrate_cursor + groups;
 
-	for (; index < table->capacity; index++) {
-		if (table->keys[index] == NULL ||
-			memcmp(table->keys[index], key, key_size) == 0) {
-			void *key_copy = alloc(key_size);
-			if (key_copy == NULL)
-				RETURN_ERROR;
+	for (; dictionary->migrate_cursor < end; dictionary->migrate_cursor++) {
+		size_t base = dictionary->migrate_cursor * HASH_GROUP_WIDTH;
 
-			memcpy(key_copy, key, key_size);
+		for (size_t i = base; i < base + HASH_GROUP_WIDTH; i++) {
+			if (!(previous->control[i] & HASH_CTRL_FULL))
+				continue;
 
-			table->keys[index] = key_copy;
-			table->data[index] = data;
-			table->element_cnt++;
+			table_insert(&dictionary->current, &previous->slots[i]);
 
-			return 0;
+			// Leave a tombstone so that entries further along the probe
+			// sequence stay reachable until they are moved too.
+			previous->control[i] = HASH_CTRL_DELETED;
+			previous->element_cnt--;
 		}
 	}
 
-	table->capacity *= 2;
+	if (previous->element_cnt == 0 ||
+		dictionary->migrate_cursor == previous->capacity / HASH_GROUP_WIDTH) {
+		free(previous->control);
+		free(previous->slots);
+
+		*previous = (struct dictionary_table){ 0 };
+		dictionary->migrate_cursor = 0;
+	}
+}
+
+static int dictionary_resize(struct dictionary *dictionary)
+{
+	// A resize can only start once the last one has finished. Inserts move
+	// groups faster than they fill the new table, so this is not expected to
+	// do any work in practice.
+	dictionary_migrate(dictionary, SIZE_MAX);
+
+	// Only grow when live entries fill the table; otherwise a same-sized
+	// rehash is enough to clear out the tombstones.
+	size_t capacity = dictionary->current.capacity;
+	if ((dictionary->current.element_cnt + 1) * 16 > capacity * 7)
+		capacity *= 2;
 
-	table->data = realloc(table->data, table->capacity * sizeof(void *));
-	if (table->data == NULL)
+	struct dictionary_table table;
+	if (table_create(&table, capacity) == -1)
 		RETURN_ERROR;
 
-	table->keys = realloc(table->keys, table->capacity * sizeof(void *));
-	if (table->keys == NULL)
+	dictionary->previous = dictionary->current;
+	dictionary->current = table;
+	dictionary->migrate_cursor = 0;
+
+	dictionary_migrate(dictionary, DICTIONARY_MIGRATE_GROUPS);
+
+	return 0;
+}
+
+int dictionary_lookup_hashed(struct dictionary *dictionary, void *key,
+							 size_t key_size, uint64_t hash, void **ret)
+{
+	if (dictionary == NULL || key == NULL || ret == NULL)
 		RETURN_ERROR;
 
-	return dictionary_push(table, key, data, key_size);
+	struct dictionary_table *table = &dictionary->current;
+	size_t index = table_find(table, key, key_size, hash);
+	if (index == DICTIONARY_NOT_FOUND) {
+		table = &dictionary->previous;
+		index = table_find(table, key, key_size, hash);
+	}
+	if (index == DICTIONARY_NOT_FOUND)
+		return -1;
+
+	*ret = table->slots[index].data;
+
+	return 0;
 }
 
-int dictionary_delete(struct dictionary *table, void *key, size_t key_size)
+int dictionary_search(struct dictionary *dictionary, void *key,
+					  size_t key_size, void **ret)
 {
-	if (table == NULL)
+	if (dictionary == NULL || key == NULL || ret == NULL)
 		RETURN_ERROR;
-	if (table->capacity == 0)
+	if (dictionary->current.capacity == 0)
+		return -1;
+
+	dictionary_migrate(dictionary, DICTIONARY_MIGRATE_GROUPS);
+
+	return dictionary_lookup_hashed(dictionary, key, key_size,
+									dictionary_hash(dictionary, key, key_size),
+									ret);
+}
+
+int dictionary_search_many(struct dictionary *dictionary, void **keys,
+						   size_t key_size, size_t n, void **ret)
+{
+	if (dictionary == NULL || keys == NULL || ret == NULL)
 		RETURN_ERROR;
+	if (dictionary->current.capacity == 0) {
+		memset(ret, 0, n * sizeof(void *));
+		return 0;
+	}
+
+	dictionary_migrate(dictionary, DICTIONARY_MIGRATE_GROUPS);
 
-	uint64_t hash = fnv_hash(key, key_size);
-	size_t index = hash & (table->capacity - 1);
+	// Hash and prefetch a whole batch before touching any table memory, so
+	// the cache misses of the batch overlap instead of being taken one by one.
+	uint64_t hashes[DICTIONARY_BATCH];
+	int found = 0;
 
-	for (; index < table->capacity; index++) {
-		if (table->keys[index] != NULL &&
-			memcmp(table->keys[index], key, key_size) == 0) {
-			table->keys[index] = NULL;
-			table->data[index] = NULL;
-			table->element_cnt--;
-			return 0;
+	for (size_t base = 0; base < n; base += DICTIONARY_BATCH) {
+		size_t count = n - base;
+		if (count > DICTIONARY_BATCH)
+			count = DICTIONARY_BATCH;
+
+		for (size_t i = 0; i < count; i++) {
+			hashes[i] = dictionary_hash(dictionary, keys[base + i], key_size);
+			table_prefetch(&dictionary->current, hashes[i]);
+			table_prefetch(&dictionary->previous, hashes[i]);
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			ret[base + i] = NULL;
+			if (dictionary_lookup_hashed(dictionary, keys[base + i], key_size,
+										 hashes[i], &ret[base + i]) == 0)
+				found++;
 		}
 	}
 
-	RETURN_ERROR;
+	return found;
 }
 
-int dictionary_destroy(struct dictionary *table)
+int dictionary_push_hashed(struct dictionary *dictionary, void *key,
+						   void *data, size_t key_size, uint64_t hash)
 {
-	if (table == NULL)
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+	if (dictionary->current.capacity == 0 &&
+		table_create(&dictionary->current, DICTIONARY_MIN_CAPACITY) == -1)
+		RETURN_ERROR;
+
+	dictionary_migrate(dictionary, DICTIONARY_MIGRATE_GROUPS);
+
+	size_t index = table_find(&dictionary->current, key, key_size, hash);
+	if (index != DICTIONARY_NOT_FOUND) {
+		dictionary->current.slots[index].data = data;
+		return 0;
+	}
+
+	index = table_find(&dictionary->previous, key, key_size, hash);
+	if (index != DICTIONARY_NOT_FOUND) {
+		dictionary->previous.slots[index].data = data;
+		return 0;
+	}
+
+	if (table_full(&dictionary->current, 1) &&
+		dictionary_resize(dictionary) == -1)
+		RETURN_ERROR;
+
+	void *key_copy = alloc(key_size);
+	if (key_copy == NULL)
 		RETURN_ERROR;
 
-	free(table->data);
+	memcpy(key_copy, key, key_size);
+
+	struct dictionary_slot slot = {
+		.hash = hash, .key = key_copy, .data = data, .key_size = key_size
+	};
+
+	table_insert(&dictionary->current, &slot);
+	dictionary->element_cnt++;
+
+	return 0;
+}
+
+int dictionary_push(struct dictionary *dictionary, void *key, void *data,
+					size_t key_size)
+{
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+
+	return dictionary_push_hashed(dictionary, key, data, key_size,
+								  dictionary_hash(dictionary, key, key_size));
+}
+
+int dictionary_delete_hashed(struct dictionary *dictionary, void *key,
+							 size_t key_size, uint64_t hash)
+{
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+	if (dictionary->current.capacity == 0)
+		RETURN_ERROR;
+
+	dictionary_migrate(dictionary, DICTIONARY_MIGRATE_GROUPS);
+
+	struct dictionary_table *table = &dictionary->current;
+	size_t index = table_find(table, key, key_size, hash);
+	if (index == DICTIONARY_NOT_FOUND) {
+		table = &dictionary->previous;
+		index = table_find(table, key, key_size, hash);
+	}
+	if (index == DICTIONARY_NOT_FOUND)
+		RETURN_ERROR;
+
+	free(table->slots[index].key);
+	table_erase(table, index);
+	dictionary->element_cnt--;
+
+	return 0;
+}
+
+int dictionary_delete(struct dictionary *dictionary, void *key,
+					  size_t key_size)
+{
+	if (dictionary == NULL || key == NULL)
+		RETURN_ERROR;
+
+	return dictionary_delete_hashed(dictionary, key, key_size,
+									dictionary_hash(dictionary, key, key_size));
+}
+
+int dictionary_destroy(struct dictionary *dictionary)
+{
+	if (dictionary == NULL)
+		RETURN_ERROR;
+
+	table_destroy(&dictionary->current);
+	table_destroy(&dictionary->previous);
+
+	*dictionary = (struct dictionary){ .seed = dictionary->seed };
 
 	return 0;
 }
@@ -4,12 +4,42 @@
 #include <stddef.h>
 #include <stdint.h>
 
-struct dictionary {
-	void **keys;
-	void **data;
+struct dictionary_slot {
+	uint64_t hash;
+	void *key;
+	void *data;
+	size_t key_size;
+};
+
+/*
+ * Open-addressing table probed HASH_GROUP_WIDTH slots at a time through the
+ * control byte array (see hash.h). capacity is a power of two and a multiple
+ * of the group width; the table is resized once it is 7/8 full.
+ */
+struct dictionary_table {
+	uint8_t *control;
+	struct dictionary_slot *slots;
 
 	size_t capacity;
 	size_t element_cnt;
+	size_t tombstone_cnt;
+};
+
+/*
+ * Resizing is incremental: the old table is kept as previous and every push,
+ * search and delete moves a few of its groups into current, so no single
+ * operation pays for rehashing the whole table. Until previous is drained
+ * both tables are consulted. Keys are hashed with a per-table random seed,
+ * picked on first use unless already set, and each slot caches the full hash
+ * of its key.
+ */
+struct dictionary {
+	struct dictionary_table current;
+	struct dictionary_table previous;
+	size_t migrate_cursor;
+
+	uint64_t seed;
+	size_t element_cnt;
 };
 
 int dictionary_push(struct dictionary *, void *, void *, size_t);
@@ -17,4 +47,24 @@ int dictionary_delete(struct dictionary *, void *, size_t);
 int dictionary_destroy(struct dictionary *);
 int dictionary_search(struct dictionary *, void *, size_t, void **);
 
+/*
+ * Look up n keys of key_size bytes each, storing each value in ret or NULL
+ * when the key is absent. Returns the number of keys found. Hashing and
+ * prefetching the keys in batches overlaps the cache misses of their lookups.
+ */
+int dictionary_search_many(struct dictionary *, void **, size_t, size_t,
+						   void **);
+
+/*
+ * Variants taking a hash computed by dictionary_hash, for callers that need
+ * the hash themselves (e.g. to pick a shard). dictionary_lookup_hashed never
+ * modifies the dictionary, so it is safe to call from concurrent readers.
+ */
+uint64_t dictionary_hash(struct dictionary *, void *, size_t);
+int dictionary_push_hashed(struct dictionary *, void *, void *, size_t,
+						   uint64_t);
+int dictionary_delete_hashed(struct dictionary *, void *, size_t, uint64_t);
+int dictionary_lookup_hashed(struct dictionary *, void *, size_t, uint64_t,
+							 void **);
+
 #endif
@@ -0,0 +1,210 @@
+#ifndef ARIA_FLAT_MAP_H_
+#define ARIA_FLAT_MAP_H_
+
+#include <aria/vector.h>
+#include <aria/slab.h>
+#include <aria/string.h>
+
+/*
+ * Sorted map kept in two parallel vectors, so a search only touches the
+ * densely packed key array. Lookups are O(log n) and inserts O(n), which
+ * suits small and read-mostly maps such as tables built once at startup
+ * with FLAT_MAP_BUILD. Keys must be integers.
+ *
+ * lower_bound halves the range without branching on the comparison until
+ * at most FLAT_MAP_SCAN_BYTES of keys remain, then counts the keys below the
+ * target in that window with vector compares.
+ */
+#define FLAT_MAP(KEY_T, VAL_T) \
+	struct {                   \
+		VECTOR(KEY_T) keys;    \
+		VECTOR(VAL_T) values;  \
+	}
+
+#define FLAT_MAP_SCAN_BYTES 64
+
+#define FLAT_MAP_LENGTH(THIS) ((THIS).keys.length)
+#define FLAT_MAP_KEY(THIS, INDEX) (VECTOR_DATA((THIS).keys)[INDEX])
+#define FLAT_MAP_VALUE(THIS, INDEX) (VECTOR_DATA((THIS).values)[INDEX])
+
+// Number of keys in [BASE, BASE + N) that are below KEY.
+#define FLAT_MAP_RANK(BASE, N, KEY)                                      \
+	({                                                                   \
+		typedef __typeof__(*(BASE)) _fr_vector_t                         \
+			__attribute__((vector_size(16)));                            \
+		const size_t _fr_lanes = sizeof(_fr_vector_t) / sizeof(*(BASE)); \
+		const __typeof__(*(BASE)) *_fr_base = (BASE);                    \
+		__typeof__(*(BASE)) _fr_key = (KEY);                             \
+		size_t _fr_n = (N), _fr_i = 0, _fr_rank = 0;                     \
+		_fr_vector_t _fr_target = (_fr_vector_t){} + _fr_key;            \
+		_fr_vector_t _fr_sum = {};                                       \
+		for (; _fr_i + _fr_lanes <= _fr_n; _fr_i += _fr_lanes) {         \
+			_fr_vector_t _fr_chunk;                                      \
+			__builtin_memcpy(&_fr_chunk, _fr_base + _fr_i,               \
+							 sizeof(_fr_chunk));                         \
+			_fr_sum -= (_fr_vector_t)(_fr_chunk < _fr_target);           \
+		}                                                                \
+		for (size_t _fr_lane = 0; _fr_lane < _fr_lanes; _fr_lane++)      \
+			_fr_rank += _fr_sum[_fr_lane];                               \
+		for (; _fr_i < _fr_n; _fr_i++)                                   \
+			_fr_rank += _fr_base[_fr_i] < _fr_key;                       \
+		_fr_rank;                                                        \
+	})
+
+// Index of the first key not below KEY, or the length if there is none.
+#define FLAT_MAP_LOWER_BOUND(THIS, KEY)                                   \
+	({                                                                    \
+		__typeof__((THIS).keys.data) _fl_keys = VECTOR_DATA((THIS).keys); \
+		__typeof__(*(THIS).keys.data) _fl_key = (KEY);                    \
+		size_t _fl_base = 0, _fl_n = (THIS).keys.length;                  \
+		while (_fl_n * sizeof(_fl_key) > FLAT_MAP_SCAN_BYTES) {           \
+			size_t _fl_half = _fl_n / 2;                                  \
+			_fl_base = (_fl_keys[_fl_base + _fl_half] < _fl_key) ?        \
+						   _fl_base + _fl_half :                          \
+						   _fl_base;                                      \
+			_fl_n -= _fl_half;                                            \
+		}                                                                 \
+		_fl_base + FLAT_MAP_RANK(_fl_keys + _fl_base, _fl_n, _fl_key);    \
+	})
+
+// Index of KEY, or SIZE_MAX if it is not in the map.
+#define FLAT_MAP_FIND(THIS, KEY)                                \
+	({                                                          \
+		__typeof__(*(THIS).keys.data) _ff_key = (KEY);          \
+		size_t _ff_index = FLAT_MAP_LOWER_BOUND(THIS, _ff_key); \
+		if (_ff_index == (THIS).keys.length ||                  \
+			FLAT_MAP_KEY(THIS, _ff_index) != _ff_key)           \
+			_ff_index = SIZE_MAX;                               \
+		_ff_index;                                              \
+	})
+
+#define FLAT_MAP_GET(THIS, KEY, RET)                 \
+	({                                               \
+		int _fg_ret = -1;                            \
+		size_t _fg_index = FLAT_MAP_FIND(THIS, KEY); \
+		if (_fg_index != SIZE_MAX) {                 \
+			RET = FLAT_MAP_VALUE(THIS, _fg_index);   \
+			_fg_ret = 0;                             \
+		}                                            \
+		_fg_ret;                                     \
+	})
+
+#define FLAT_MAP_PUT(THIS, KEY, VALUE)                                   \
+	({                                                                   \
+		__label__ _fp_out;                                               \
+		int _fp_ret = 0;                                                 \
+		__typeof__(*(THIS).keys.data) _fp_key = (KEY);                   \
+		size_t _fp_index = FLAT_MAP_LOWER_BOUND(THIS, _fp_key);          \
+		size_t _fp_length = (THIS).keys.length;                          \
+		if (_fp_index < _fp_length &&                                    \
+			FLAT_MAP_KEY(THIS, _fp_index) == _fp_key) {                  \
+			FLAT_MAP_VALUE(THIS, _fp_index) = (VALUE);                   \
+			goto _fp_out;                                                \
+		}                                                                \
+		if (VECTOR_GROW((THIS).keys, _fp_length + 1) == -1 ||            \
+			VECTOR_GROW((THIS).values, _fp_length + 1) == -1) {          \
+			_fp_ret = -1;                                                \
+			goto _fp_out;                                                \
+		}                                                                \
+		memmove(&FLAT_MAP_KEY(THIS, _fp_index + 1),                      \
+				&FLAT_MAP_KEY(THIS, _fp_index),                          \
+				(_fp_length - _fp_index) * sizeof(_fp_key));             \
+		memmove(&FLAT_MAP_VALUE(THIS, _fp_index + 1),                    \
+				&FLAT_MAP_VALUE(THIS, _fp_index),                        \
+				(_fp_length - _fp_index) * sizeof(*(THIS).values.data)); \
+		FLAT_MAP_KEY(THIS, _fp_index) = _fp_key;                         \
+		FLAT_MAP_VALUE(THIS, _fp_index) = (VALUE);                       \
+		(THIS).keys.length++;                                            \
+		(THIS).values.length++;                                          \
+_fp_out:                                                                 \
+		_fp_ret;                                                         \
+	})
+
+#define FLAT_MAP_DELETE(THIS, KEY)                            \
+	({                                                        \
+		int _fd_ret = -1;                                     \
+		size_t _fd_index = FLAT_MAP_FIND(THIS, KEY);          \
+		if (_fd_index != SIZE_MAX) {                          \
+			VECTOR_REMOVE_BY_INDEX((THIS).keys, _fd_index);   \
+			VECTOR_REMOVE_BY_INDEX((THIS).values, _fd_index); \
+			_fd_ret = 0;                                      \
+		}                                                     \
+		_fd_ret;                                              \
+	})
+
+/*
+ * Add N unsorted key/value pairs and restore the order with a single stable
+ * bottom-up merge sort of the whole map. When a key appears more than once
+ * the value added last wins, as with repeated FLAT_MAP_PUTs.
+ */
+#define FLAT_MAP_BUILD(THIS, KEYS, VALUES, N)                                 \
+	({                                                                        \
+		__label__ _fb_out;                                                    \
+		int _fb_ret = -1;                                                     \
+		size_t _fb_n = (N);                                                   \
+		if (VECTOR_GROW((THIS).keys, (THIS).keys.length + _fb_n) == -1 ||     \
+			VECTOR_GROW((THIS).values, (THIS).values.length + _fb_n) == -1)   \
+			goto _fb_out;                                                     \
+		size_t _fb_length = (THIS).keys.length + _fb_n;                       \
+		__typeof__((THIS).keys.data) _fb_kt =                                 \
+			alloc(_fb_length * sizeof(*(THIS).keys.data));                    \
+		__typeof__((THIS).values.data) _fb_vt =                               \
+			alloc(_fb_length * sizeof(*(THIS).values.data));                  \
+		if (_fb_kt == NULL || _fb_vt == NULL) {                               \
+			free(_fb_kt);                                                     \
+			free(_fb_vt);                                                     \
+			goto _fb_out;                                                     \
+		}                                                                     \
+		VECTOR_APPEND_N((THIS).keys, (KEYS), _fb_n);                          \
+		VECTOR_APPEND_N((THIS).values, (VALUES), _fb_n);                      \
+		__typeof__((THIS).keys.data) _fb_ks = VECTOR_DATA((THIS).keys);       \
+		__typeof__((THIS).values.data) _fb_vs = VECTOR_DATA((THIS).values);   \
+		for (size_t _fb_w = 1; _fb_w < _fb_length; _fb_w *= 2) {              \
+			for (size_t _fb_lo = 0; _fb_lo < _fb_length;                      \
+				 _fb_lo += 2 * _fb_w) {                                       \
+				size_t _fb_mid = _fb_lo + _fb_w;                              \
+				size_t _fb_hi = _fb_lo + 2 * _fb_w;                           \
+				if (_fb_mid > _fb_length)                                     \
+					_fb_mid = _fb_length;                                     \
+				if (_fb_hi > _fb_length)                                      \
+					_fb_hi = _fb_length;                                      \
+				size_t _fb_i = _fb_lo, _fb_j = _fb_mid;                       \
+				for (size_t _fb_k = _fb_lo; _fb_k < _fb_hi; _fb_k++) {        \
+					size_t _fb_src =                                          \
+						(_fb_j < _fb_hi &&                                    \
+						 (_fb_i == _fb_mid || _fb_ks[_fb_j] < _fb_ks[_fb_i])) \
+							? _fb_j++                                         \
+							: _fb_i++;                                        \
+					_fb_kt[_fb_k] = _fb_ks[_fb_src];                          \
+					_fb_vt[_fb_k] = _fb_vs[_fb_src];                          \
+				}                                                             \
+			}                                                                 \
+			__typeof__(_fb_ks) _fb_ktmp = _fb_ks;                             \
+			__typeof__(_fb_vs) _fb_vtmp = _fb_vs;                             \
+			_fb_ks = _fb_kt;                                                  \
+			_fb_vs = _fb_vt;                                                  \
+			_fb_kt = _fb_ktmp;                                                \
+			_fb_vt = _fb_vtmp;                                                \
+		}                                                                     \
+		size_t _fb_out_n = 0;                                                 \
+		__typeof__((THIS).keys.data) _fb_kd = VECTOR_DATA((THIS).keys);       \
+		__typeof__((THIS).values.data) _fb_vd = VECTOR_DATA((THIS).values);   \
+		for (size_t _fb_k = 0; _fb_k < _fb_length; _fb_k++) {                 \
+			if (_fb_out_n == 0 || _fb_ks[_fb_k] != _fb_kd[_fb_out_n - 1])     \
+				_fb_kd[_fb_out_n++] = _fb_ks[_fb_k];                          \
+			_fb_vd[_fb_out_n - 1] = _fb_vs[_fb_k];                            \
+		}                                                                     \
+		(THIS).keys.length = _fb_out_n;                                       \
+		(THIS).values.length = _fb_out_n;                                     \
+		free(_fb_ks == _fb_kd ? _fb_kt : _fb_ks);                             \
+		free(_fb_vs == _fb_vd ? _fb_vt : _fb_vs);                             \
+		_fb_ret = 0;                                                          \
+_fb_out:                                                                      \
+		_fb_ret;                                                              \
+	})
+
+#define FLAT_MAP_CLEAR(THIS)     \
+	VECTOR_CLEAR((THIS).keys);   \
+	VECTOR_CLEAR((THIS).values);
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef ARIA_HASH_H_
+#define ARIA_HASH_H_
+
+#include <aria/random.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Control bytes for open-addressing tables probed a group at a time. A full
+ * slot stores the low 7 bits of its hash with the top bit set, so empty and
+ * deleted slots are the ones with the top bit clear and a zeroed control
+ * array is an empty table.
+ */
+constexpr uint8_t HASH_CTRL_EMPTY = 0x00;
+constexpr uint8_t HASH_CTRL_DELETED = 0x01;
+constexpr uint8_t HASH_CTRL_FULL = 0x80;
+
+constexpr size_t HASH_GROUP_WIDTH = 16;
+
+#define HASH_TAG(HASH) ((uint8_t)(HASH_CTRL_FULL | ((HASH) & 0x7f)))
+#define HASH_GROUP(HASH) ((HASH) >> 7)
+
+#ifdef __SSE2__
+
+typedef char hash_group_t __attribute__((vector_size(16)));
+
+static inline uint32_t hash_group_match(const uint8_t *group, uint8_t tag)
+{
+	hash_group_t control;
+	__builtin_memcpy(&control, group, sizeof(control));
+	return __builtin_ia32_pmovmskb128(control == (char)tag);
+}
+
+static inline uint32_t hash_group_match_free(const uint8_t *group)
+{
+	hash_group_t control;
+	__builtin_memcpy(&control, group, sizeof(control));
+	return ~__builtin_ia32_pmovmskb128(control) & 0xffff;
+}
+
+#else
+
+static inline uint32_t hash_group_match(const uint8_t *group, uint8_t tag)
+{
+	uint32_t mask = 0;
+	for (size_t i = 0; i < HASH_GROUP_WIDTH; i++)
+		mask |= (uint32_t)(group[i] == tag) << i;
+	return mask;
+}
+
+static inline uint32_t hash_group_match_free(const uint8_t *group)
+{
+	uint32_t mask = 0;
+	for (size_t i = 0; i < HASH_GROUP_WIDTH; i++)
+		mask |= (uint32_t)!(group[i] & HASH_CTRL_FULL) << i;
+	return mask;
+}
+
+#endif
+
+static inline uint32_t hash_group_match_empty(const uint8_t *group)
+{
+	return hash_group_match(group, HASH_CTRL_EMPTY);
+}
+
+/*
+ * Find the first empty or deleted slot along the probe sequence of hash.
+ * Groups are visited with triangular probing, which covers every group of a
+ * power of two sized table exactly once.
+ */
+static inline size_t hash_find_free(const uint8_t *control, size_t capacity,
+									uint64_t hash)
+{
+	size_t mask = capacity / HASH_GROUP_WIDTH - 1;
+	size_t group = HASH_GROUP(hash) & mask;
+
+	for (size_t probe = 1; probe <= mask + 1; probe++) {
+		uint32_t match =
+			hash_group_match_free(control + group * HASH_GROUP_WIDTH);
+		if (match)
+			return group * HASH_GROUP_WIDTH + __builtin_ctz(match);
+
+		group = (group + probe) & mask;
+	}
+
+	return SIZE_MAX;
+}
+
+/*
+ * Seeded hash over arbitrary bytes, following the structure of wyhash: the
+ * input is consumed 16 bytes at a time and every step is folded with a single
+ * 64x64->128 bit multiply. Tables pick a random seed so that colliding keys
+ * cannot be chosen ahead of time.
+ */
+constexpr uint64_t HASH_SECRET0 = 0xa0761d6478bd642full;
+constexpr uint64_t HASH_SECRET1 = 0xe7037ed1a0b428dbull;
+constexpr uint64_t HASH_SECRET2 = 0x8ebc6af09c88c6e3ull;
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+	unsigned __int128 product = (unsigned __int128)a * b;
+	return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t hash_read64(const uint8_t *data)
+{
+	uint64_t value;
+	__builtin_memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t hash_read32(const uint8_t *data)
+{
+	uint32_t value;
+	__builtin_memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t hash_bytes(const void *key, size_t length,
+								  uint64_t seed)
+{
+	const uint8_t *data = key;
+	uint64_t a, b;
+
+	seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+
+	if (length <= 16) {
+		if (length >= 4) {
+			size_t middle = (length >> 3) << 2;
+			a = (hash_read32(data) << 32) | hash_read32(data + middle);
+			b = (hash_read32(data + length - 4) << 32) |
+				hash_read32(data + length - 4 - middle);
+		} else if (length > 0) {
+			a = ((uint64_t)data[0] << 16) |
+				((uint64_t)data[length >> 1] << 8) | data[length - 1];
+			b = 0;
+		} else {
+			a = 0;
+			b = 0;
+		}
+	} else {
+		size_t remaining = length;
+		for (; remaining > 16; remaining -= 16, data += 16)
+			seed = hash_mix(hash_read64(data) ^ HASH_SECRET2,
+							hash_read64(data + 8) ^ seed);
+		a = hash_read64(data + remaining - 16);
+		b = hash_read64(data + remaining - 8);
+	}
+
+	unsigned __int128 product =
+		(unsigned __int128)(a ^ HASH_SECRET1) * (b ^ seed);
+
+	return hash_mix((uint64_t)product ^ HASH_SECRET0 ^ length,
+					(uint64_t)(product >> 64) ^ HASH_SECRET1);
+}
+
+/* Single multiply hash for keys that fit in a machine word. */
+static inline uint64_t hash_u64(uint64_t key, uint64_t seed)
+{
+	return hash_mix(key ^ HASH_SECRET0, seed ^ HASH_SECRET1);
+}
+
+static inline uint64_t hash_seed(void)
+{
+	return random_u64();
+}
+
+#endif
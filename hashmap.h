@@ -0,0 +1,199 @@
+#ifndef ARIA_HASHMAP_H_
+#define ARIA_HASHMAP_H_
+
+#include <aria/slab.h>
+#include <aria/string.h>
+#include <aria/hash.h>
+
+/*
+ * Typed open-addressing map with fixed-size keys and values stored inline in
+ * the slot array, probed through the same control bytes as the dictionary.
+ * Keys of 4 or 8 bytes (capability_t, uintptr_t, ...) are hashed with a
+ * single multiply and compared as integers; anything else goes through
+ * hash_bytes and memcmp.
+ */
+#define HASHMAP(KEY_T, VAL_T) \
+	struct {                  \
+		uint8_t *control;     \
+		struct {              \
+			KEY_T key;        \
+			VAL_T value;      \
+		} *slots;             \
+		size_t capacity;      \
+		size_t length;        \
+		size_t tombstone_cnt; \
+		uint64_t seed;        \
+	}
+
+#define HASHMAP_HASH(THIS, KEY_PTR)                                          \
+	({                                                                       \
+		const uint8_t *_hh_key = (const uint8_t *)(KEY_PTR);                 \
+		uint64_t _hh_hash;                                                   \
+		if (sizeof((THIS).slots->key) == sizeof(uint64_t))                   \
+			_hh_hash = hash_u64(hash_read64(_hh_key), (THIS).seed);          \
+		else if (sizeof((THIS).slots->key) == sizeof(uint32_t))              \
+			_hh_hash = hash_u64(hash_read32(_hh_key), (THIS).seed);          \
+		else                                                                 \
+			_hh_hash =                                                       \
+				hash_bytes(_hh_key, sizeof((THIS).slots->key), (THIS).seed); \
+		_hh_hash;                                                            \
+	})
+
+#define HASHMAP_KEY_EQUAL(THIS, A_PTR, B_PTR)                \
+	({                                                       \
+		const uint8_t *_he_a = (const uint8_t *)(A_PTR);     \
+		const uint8_t *_he_b = (const uint8_t *)(B_PTR);     \
+		(sizeof((THIS).slots->key) == sizeof(uint64_t)) ?    \
+			hash_read64(_he_a) == hash_read64(_he_b) :       \
+		(sizeof((THIS).slots->key) == sizeof(uint32_t)) ?    \
+			hash_read32(_he_a) == hash_read32(_he_b) :       \
+			memcmp((const char *)_he_a, (const char *)_he_b, \
+				   sizeof((THIS).slots->key)) == 0;          \
+	})
+
+#define HASHMAP_FIND_HASHED(THIS, KEY_PTR, HASH)                             \
+	({                                                                       \
+		__label__ _hf_out;                                                   \
+		size_t _hf_ret = SIZE_MAX;                                           \
+		uint64_t _hf_hash = (HASH);                                          \
+		if ((THIS).capacity == 0)                                            \
+			goto _hf_out;                                                    \
+		size_t _hf_mask = (THIS).capacity / HASH_GROUP_WIDTH - 1;            \
+		size_t _hf_group = HASH_GROUP(_hf_hash) & _hf_mask;                  \
+		for (size_t _hf_probe = 1; _hf_probe <= _hf_mask + 1; _hf_probe++) { \
+			uint8_t *_hf_control =                                           \
+				(THIS).control + _hf_group * HASH_GROUP_WIDTH;               \
+			uint32_t _hf_match =                                             \
+				hash_group_match(_hf_control, HASH_TAG(_hf_hash));           \
+			for (; _hf_match; _hf_match &= _hf_match - 1) {                  \
+				size_t _hf_index =                                           \
+					_hf_group * HASH_GROUP_WIDTH + __builtin_ctz(_hf_match); \
+				if (HASHMAP_KEY_EQUAL(THIS, &(THIS).slots[_hf_index].key,    \
+									  KEY_PTR)) {                            \
+					_hf_ret = _hf_index;                                     \
+					goto _hf_out;                                            \
+				}                                                            \
+			}                                                                \
+			if (hash_group_match_empty(_hf_control))                         \
+				goto _hf_out;                                                \
+			_hf_group = (_hf_group + _hf_probe) & _hf_mask;                  \
+		}                                                                    \
+_hf_out:                                                                     \
+		_hf_ret;                                                             \
+	})
+
+#define HASHMAP_FIND(THIS, KEY)                             \
+	({                                                      \
+		__typeof__((THIS).slots->key) _hfk_key = (KEY);     \
+		HASHMAP_FIND_HASHED(THIS, &_hfk_key,                \
+							HASHMAP_HASH(THIS, &_hfk_key)); \
+	})
+
+#define HASHMAP_RESIZE(THIS, CAPACITY)                                        \
+	({                                                                        \
+		__label__ _hr_out;                                                    \
+		int _hr_ret = 0;                                                      \
+		size_t _hr_capacity = (CAPACITY);                                     \
+		uint8_t *_hr_control = alloc(_hr_capacity);                           \
+		__typeof__((THIS).slots) _hr_slots =                                  \
+			alloc(_hr_capacity * sizeof(*(THIS).slots));                      \
+		if (_hr_control == NULL || _hr_slots == NULL) {                       \
+			free(_hr_control);                                                \
+			free(_hr_slots);                                                  \
+			_hr_ret = -1;                                                     \
+			goto _hr_out;                                                     \
+		}                                                                     \
+		if ((THIS).seed == 0)                                                 \
+			(THIS).seed = hash_seed();                                        \
+		for (size_t _hr_i = 0; _hr_i < (THIS).capacity; _hr_i++) {            \
+			if (!((THIS).control[_hr_i] & HASH_CTRL_FULL))                    \
+				continue;                                                     \
+			uint64_t _hr_hash = HASHMAP_HASH(THIS, &(THIS).slots[_hr_i].key); \
+			size_t _hr_index =                                                \
+				hash_find_free(_hr_control, _hr_capacity, _hr_hash);          \
+			_hr_control[_hr_index] = HASH_TAG(_hr_hash);                      \
+			_hr_slots[_hr_index] = (THIS).slots[_hr_i];                       \
+		}                                                                     \
+		free((THIS).control);                                                 \
+		free((THIS).slots);                                                   \
+		(THIS).control = _hr_control;                                         \
+		(THIS).slots = _hr_slots;                                             \
+		(THIS).capacity = _hr_capacity;                                       \
+		(THIS).tombstone_cnt = 0;                                             \
+_hr_out:                                                                      \
+		_hr_ret;                                                              \
+	})
+
+#define HASHMAP_PUT(THIS, KEY, VALUE)                                      \
+	({                                                                     \
+		__label__ _hp_out;                                                 \
+		int _hp_ret = 0;                                                   \
+		__typeof__((THIS).slots->key) _hp_key = (KEY);                     \
+		if (((THIS).length + (THIS).tombstone_cnt + 1) * 8 >               \
+			(THIS).capacity * 7) {                                         \
+			size_t _hp_capacity =                                          \
+				(THIS).capacity ? (THIS).capacity : HASH_GROUP_WIDTH;      \
+			if (((THIS).length + 1) * 16 > _hp_capacity * 7)               \
+				_hp_capacity *= 2;                                         \
+			if (HASHMAP_RESIZE(THIS, _hp_capacity) == -1) {                \
+				_hp_ret = -1;                                              \
+				goto _hp_out;                                              \
+			}                                                              \
+		}                                                                  \
+		uint64_t _hp_hash = HASHMAP_HASH(THIS, &_hp_key);                  \
+		size_t _hp_index = HASHMAP_FIND_HASHED(THIS, &_hp_key, _hp_hash);  \
+		if (_hp_index == SIZE_MAX) {                                       \
+			_hp_index =                                                    \
+				hash_find_free((THIS).control, (THIS).capacity, _hp_hash); \
+			if ((THIS).control[_hp_index] == HASH_CTRL_DELETED)            \
+				(THIS).tombstone_cnt--;                                    \
+			(THIS).control[_hp_index] = HASH_TAG(_hp_hash);                \
+			(THIS).slots[_hp_index].key = _hp_key;                         \
+			(THIS).length++;                                               \
+		}                                                                  \
+		(THIS).slots[_hp_index].value = (VALUE);                           \
+_hp_out:                                                                   \
+		_hp_ret;                                                           \
+	})
+
+#define HASHMAP_GET(THIS, KEY, RET)                 \
+	({                                              \
+		int _hg_ret = -1;                           \
+		size_t _hg_index = HASHMAP_FIND(THIS, KEY); \
+		if (_hg_index != SIZE_MAX) {                \
+			RET = (THIS).slots[_hg_index].value;    \
+			_hg_ret = 0;                            \
+		}                                           \
+		_hg_ret;                                    \
+	})
+
+#define HASHMAP_DELETE(THIS, KEY)                                            \
+	({                                                                       \
+		__label__ _hd_out;                                                   \
+		int _hd_ret = -1;                                                    \
+		size_t _hd_index = HASHMAP_FIND(THIS, KEY);                          \
+		if (_hd_index == SIZE_MAX)                                           \
+			goto _hd_out;                                                    \
+		if (hash_group_match_empty((THIS).control +                          \
+								   (_hd_index & ~(HASH_GROUP_WIDTH - 1)))) { \
+			(THIS).control[_hd_index] = HASH_CTRL_EMPTY;                     \
+		} else {                                                             \
+			(THIS).control[_hd_index] = HASH_CTRL_DELETED;                   \
+			(THIS).tombstone_cnt++;                                          \
+		}                                                                    \
+		(THIS).length--;                                                     \
+		_hd_ret = 0;                                                         \
+_hd_out:                                                                     \
+		_hd_ret;                                                             \
+	})
+
+#define HASHMAP_CLEAR(THIS)   \
+	free((THIS).control);     \
+	free((THIS).slots);       \
+	(THIS).control = NULL;    \
+	(THIS).slots = NULL;      \
+	(THIS).capacity = 0;      \
+	(THIS).length = 0;        \
+	(THIS).tombstone_cnt = 0;
+
+#endif
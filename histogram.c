@@ -0,0 +1,85 @@
+#include <aria/histogram.h>
+#include <aria/string.h>
+
+void histogram_init(struct histogram *histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+	histogram->min = UINT64_MAX;
+}
+
+void histogram_merge(struct histogram *dest, const struct histogram *src)
+{
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+		dest->counts[i] += src->counts[i];
+
+	dest->total += src->total;
+	dest->sum += src->sum;
+
+	if (src->min < dest->min)
+		dest->min = src->min;
+	if (src->max > dest->max)
+		dest->max = src->max;
+}
+
+uint64_t histogram_percentile(const struct histogram *histogram,
+							  uint32_t percentile)
+{
+	if (histogram->total == 0)
+		return 0;
+
+	if (percentile > HISTOGRAM_PERCENTILE_SCALE)
+		percentile = HISTOGRAM_PERCENTILE_SCALE;
+
+	/* Rank of the value in question, rounded up and at least the first */
+	uint64_t rank = ((unsigned __int128)histogram->total * percentile +
+					 HISTOGRAM_PERCENTILE_SCALE - 1) /
+					HISTOGRAM_PERCENTILE_SCALE;
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	size_t index = 0;
+	for (; index < HISTOGRAM_BUCKETS - 1; index++) {
+		seen += histogram->counts[index];
+		if (seen >= rank)
+			break;
+	}
+
+	uint64_t value = (index == HISTOGRAM_BUCKETS - 1) ?
+						 UINT64_MAX :
+						 histogram_value(index + 1) - 1;
+
+	if (value > histogram->max)
+		value = histogram->max;
+	if (value < histogram->min)
+		value = histogram->min;
+
+	return value;
+}
+
+uint64_t histogram_mean(const struct histogram *histogram)
+{
+	if (histogram->total == 0)
+		return 0;
+
+	return histogram->sum / histogram->total;
+}
+
+int histogram_print(const struct histogram *histogram,
+					struct stream_info *stream, const char *name)
+{
+	if (histogram == NULL || stream == NULL || stream->write == NULL)
+		return -1;
+
+	uint64_t min = histogram->total ? histogram->min : 0;
+
+	stream_printf(stream, "%s: count=%d min=%d mean=%d", name,
+				  histogram->total, min, histogram_mean(histogram));
+	stream_printf(stream, " p50=%d p90=%d p99=%d p999=%d max=%d\n",
+				  histogram_percentile(histogram, 500000),
+				  histogram_percentile(histogram, 900000),
+				  histogram_percentile(histogram, 990000),
+				  histogram_percentile(histogram, 999000), histogram->max);
+
+	return 0;
+}
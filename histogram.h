@@ -0,0 +1,98 @@
+#ifndef ARIA_HISTOGRAM_H_
+#define ARIA_HISTOGRAM_H_
+
+#include <aria/stream.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * High dynamic range histogram of 64-bit values such as latencies in
+ * nanoseconds or cycles. Values below 2^HISTOGRAM_SUB_BUCKET_BITS get a
+ * bucket each; above that every power of two is split into
+ * 2^HISTOGRAM_SUB_BUCKET_BITS linear sub-buckets, so any value is recorded
+ * to within 1 / 2^HISTOGRAM_SUB_BUCKET_BITS of itself.
+ *
+ * A histogram is meant to be owned by a single thread, which records into
+ * it with plain increments. Per-thread histograms are combined with
+ * histogram_merge before they are queried.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS \
+	((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/* Percentiles are given in parts per million, so 99.9% is 999000 */
+#define HISTOGRAM_PERCENTILE_SCALE 1000000
+
+struct histogram {
+	uint64_t total;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t counts[HISTOGRAM_BUCKETS];
+};
+
+static inline size_t histogram_index(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return value;
+
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+
+	return ((size_t)(shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) +
+		   ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* Smallest value recorded in the bucket at index */
+static inline uint64_t histogram_value(size_t index)
+{
+	size_t group = index >> HISTOGRAM_SUB_BUCKET_BITS;
+	uint64_t sub_bucket = index & (HISTOGRAM_SUB_BUCKETS - 1);
+
+	if (group == 0)
+		return sub_bucket;
+
+	return (HISTOGRAM_SUB_BUCKETS + sub_bucket) << (group - 1);
+}
+
+void histogram_init(struct histogram *histogram);
+
+static inline void histogram_record_n(struct histogram *histogram,
+									  uint64_t value, uint64_t n)
+{
+	histogram->counts[histogram_index(value)] += n;
+	histogram->total += n;
+	histogram->sum += value * n;
+
+	if (value < histogram->min)
+		histogram->min = value;
+	if (value > histogram->max)
+		histogram->max = value;
+}
+
+static inline void histogram_record(struct histogram *histogram,
+									uint64_t value)
+{
+	histogram_record_n(histogram, value, 1);
+}
+
+/* Add everything recorded in src to dest */
+void histogram_merge(struct histogram *dest, const struct histogram *src);
+
+/*
+ * Value below or at which percentile parts per million of the recorded
+ * values lie, reported as the largest value of its bucket. Returns 0 for an
+ * empty histogram.
+ */
+uint64_t histogram_percentile(const struct histogram *histogram,
+							  uint32_t percentile);
+
+uint64_t histogram_mean(const struct histogram *histogram);
+
+/* Print count, min, mean, p50, p90, p99, p999 and max on a single line */
+int histogram_print(const struct histogram *histogram,
+					struct stream_info *stream, const char *name);
+
+#endif
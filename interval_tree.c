@@ -0,0 +1,126 @@
+#include <aria/interval_tree.h>
+
+#define INTERVAL_TREE_AUGMENT(NODE) interval_tree_augment(NODE)
+
+static inline void interval_tree_augment(struct interval_tree_node *node)
+{
+	uint64_t end = node->end;
+
+	if (node->left && node->left->subtree_end > end)
+		end = node->left->subtree_end;
+	if (node->right && node->right->subtree_end > end)
+		end = node->right->subtree_end;
+
+	node->subtree_end = end;
+}
+
+/*
+ * Leftmost interval in the subtree of node that overlaps [start, end). The
+ * caller guarantees node->subtree_end > start.
+ */
+static struct interval_tree_node *
+interval_tree_subtree_search(struct interval_tree_node *node, uint64_t start,
+							 uint64_t end)
+{
+	for (;;) {
+		// If anything on the left ends after start, the leftmost such
+		// interval is the only candidate: everything to its right starts
+		// no earlier, so it overlaps only if that one does.
+		if (node->left && node->left->subtree_end > start) {
+			node = node->left;
+			continue;
+		}
+
+		if (node->start >= end)
+			return NULL;
+		if (node->end > start)
+			return node;
+
+		node = node->right;
+		if (node == NULL || node->subtree_end <= start)
+			return NULL;
+	}
+}
+
+void interval_tree_init(struct interval_tree *tree)
+{
+	tree->root = NULL;
+	tree->size = 0;
+}
+
+int interval_tree_insert(struct interval_tree *tree,
+						 struct interval_tree_node *node)
+{
+	if (tree == NULL || node == NULL || node->start >= node->end)
+		return -1;
+
+	node->subtree_end = node->end;
+	if (RB_AUGMENTED_INSERT(tree->root, start, node, INTERVAL_TREE_AUGMENT) ==
+		-1)
+		return -1;
+
+	tree->size++;
+
+	return 0;
+}
+
+int interval_tree_delete(struct interval_tree *tree,
+						 struct interval_tree_node *node)
+{
+	if (tree == NULL || node == NULL)
+		return -1;
+
+	if (RB_AUGMENTED_DELETE(tree->root, node, INTERVAL_TREE_AUGMENT) == -1)
+		return -1;
+
+	tree->size--;
+
+	return 0;
+}
+
+struct interval_tree_node *
+interval_tree_first_overlap(struct interval_tree *tree, uint64_t start,
+							uint64_t end)
+{
+	struct interval_tree_node *root = tree->root;
+	if (root == NULL || start >= end || root->subtree_end <= start)
+		return NULL;
+
+	return interval_tree_subtree_search(root, start, end);
+}
+
+struct interval_tree_node *
+interval_tree_next_overlap(struct interval_tree_node *node, uint64_t start,
+						   uint64_t end)
+{
+	for (;;) {
+		// Anything overlapping in the right subtree comes first in order.
+		// If none of it does, nothing after it can either.
+		struct interval_tree_node *right = node->right;
+		if (right && right->subtree_end > start)
+			return interval_tree_subtree_search(right, start, end);
+
+		// Climb to the next ancestor that has node in its left subtree.
+		struct interval_tree_node *previous;
+		do {
+			previous = node;
+			node = node->parent;
+			if (node == NULL)
+				return NULL;
+		} while (node->right == previous);
+
+		if (node->start >= end)
+			return NULL;
+		if (node->end > start)
+			return node;
+	}
+}
+
+struct interval_tree_node *interval_tree_stab(struct interval_tree *tree,
+											  uint64_t point)
+{
+	if (point == UINT64_MAX)
+		return NULL;
+
+	return interval_tree_first_overlap(tree, point, point + 1);
+}
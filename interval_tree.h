@@ -0,0 +1,54 @@
+#ifndef ARIA_INTERVAL_TREE_H_
+#define ARIA_INTERVAL_TREE_H_
+
+#include <aria/rb_tree.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Red-black tree of half-open ranges [start, end), ordered by start. Every
+ * node also records the largest end in its subtree, which lets stab and
+ * overlap queries skip any subtree that ends before the range of interest,
+ * so they run in O(log n) plus O(log n) per match. The containing object can
+ * be retrieved using CONTAINER_OF.
+ */
+struct interval_tree_node {
+	RB_META(struct interval_tree_node)
+
+	uint64_t start;
+	uint64_t end;
+	uint64_t subtree_end;
+};
+
+struct interval_tree {
+	struct interval_tree_node *root;
+	size_t size;
+};
+
+void interval_tree_init(struct interval_tree *tree);
+
+/* start and end must be set, with start < end */
+int interval_tree_insert(struct interval_tree *tree,
+						 struct interval_tree_node *node);
+int interval_tree_delete(struct interval_tree *tree,
+						 struct interval_tree_node *node);
+
+/* The interval with the lowest start that contains point, if any */
+struct interval_tree_node *interval_tree_stab(struct interval_tree *tree,
+											  uint64_t point);
+
+/*
+ * Iterate over every interval overlapping [start, end) in order of start:
+ *
+ * for (node = interval_tree_first_overlap(tree, start, end); node;
+ *      node = interval_tree_next_overlap(node, start, end))
+ */
+struct interval_tree_node *
+interval_tree_first_overlap(struct interval_tree *tree, uint64_t start,
+							uint64_t end);
+struct interval_tree_node *
+interval_tree_next_overlap(struct interval_tree_node *node, uint64_t start,
+						   uint64_t end);
+
+#endif
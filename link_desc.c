@@ -0,0 +1,367 @@
+#include <aria/link_desc.h>
+#include <aria/compiler.h>
+#include <aria/address.h>
+#include <aria/syscall.h>
+#include <aria/string.h>
+#include <aria/sched.h>
+#include <aria/slab.h>
+#include <aria/debug.h>
+
+// Per-call view of a link. The geometry and entries sit in memory shared
+// with the peer, so they are read and checked once on every call and only
+// the copies are used afterwards.
+struct link_desc_view {
+	struct link_desc_ring *ring;
+	struct link_desc *submit;
+	struct link_desc *complete;
+	uint32_t entries;
+};
+
+static bool link_desc_geometry_valid(struct portal_link *link,
+									 struct link_geometry *geometry)
+{
+	if (unlikely(link == NULL || link->magic != LINK_VECTOR_MAGIC))
+		return false;
+
+	link_geometry_read(link, geometry);
+
+	return link_geometry_valid(geometry) &&
+		   geometry->header_limit >= sizeof(struct link_desc_ring);
+}
+
+static int link_desc_view(struct portal_link *link,
+						  struct link_desc_view *view)
+{
+	struct link_geometry geometry;
+	if (unlikely(!link_desc_geometry_valid(link, &geometry)))
+		return -1;
+
+	view->ring =
+		(struct link_desc_ring *)(link->data + geometry.header_offset);
+
+	uint32_t limit = geometry.data_limit / (2 * sizeof(struct link_desc));
+	uint32_t entries = __atomic_load_n(&view->ring->entries, __ATOMIC_RELAXED);
+	if (unlikely(entries == 0 || (entries & (entries - 1)) != 0 ||
+				 entries > limit))
+		return -1;
+
+	view->submit = (struct link_desc *)(link->data + geometry.data_offset);
+	view->complete = view->submit + entries;
+	view->entries = entries;
+
+	return 0;
+}
+
+static int link_desc_push(struct link_desc_queue *queue,
+						  struct link_desc *array, uint32_t entries,
+						  const struct link_desc *descs, size_t n)
+{
+	uint32_t producer = queue->producer;
+	uint32_t consumer = __atomic_load_n(&queue->consumer, __ATOMIC_ACQUIRE);
+	if (n == 0 || n > entries - (producer - consumer))
+		return -1;
+
+	uint32_t position = producer & (entries - 1);
+	size_t first = entries - position;
+	if (first > n)
+		first = n;
+
+	memcpy(array + position, descs, first * sizeof(struct link_desc));
+	memcpy(array, descs + first, (n - first) * sizeof(struct link_desc));
+
+	__atomic_store_n(&queue->producer, producer + n, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&queue->consumer_waiting, __ATOMIC_SEQ_CST))
+		futex_wake(&queue->producer, INT32_MAX);
+
+	return n;
+}
+
+static void link_desc_consume(struct link_desc_queue *queue, uint32_t consumer)
+{
+	__atomic_store_n(&queue->consumer, consumer, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&queue->producer_waiting, __ATOMIC_SEQ_CST))
+		futex_wake(&queue->consumer, INT32_MAX);
+}
+
+// Length of the chain at the consumer index, 0 if the queue is empty or -1
+// if the chain runs past the producer index. Chains are published with a
+// single index update, so such a chain is malformed.
+static int link_desc_chain_length(struct link_desc_queue *queue,
+								  struct link_desc *array, uint32_t entries,
+								  uint32_t consumer)
+{
+	uint32_t producer = __atomic_load_n(&queue->producer, __ATOMIC_ACQUIRE);
+	uint32_t available = producer - consumer;
+	if (available == 0)
+		return 0;
+	if (unlikely(available > entries))
+		return -1;
+
+	for (uint32_t n = 0; n < available; n++) {
+		uint32_t flags = __atomic_load_n(
+			&array[(consumer + n) & (entries - 1)].flags, __ATOMIC_RELAXED);
+		if (!(flags & LINK_DESC_NEXT))
+			return n + 1;
+	}
+
+	return -1;
+}
+
+static int link_desc_pop(struct link_desc_queue *queue,
+						 struct link_desc *array, uint32_t entries,
+						 struct link_desc *descs, size_t max)
+{
+	uint32_t consumer = queue->consumer;
+	int n = link_desc_chain_length(queue, array, entries, consumer);
+	if (n == 0)
+		return 0;
+
+	// A malformed chain is dropped with everything published after it, so
+	// it cannot block the queue.
+	if (unlikely(n == -1)) {
+		link_desc_consume(queue,
+						  __atomic_load_n(&queue->producer, __ATOMIC_ACQUIRE));
+		RETURN_ERROR;
+	}
+
+	// A chain longer than descs stays queued; the caller can size its array
+	// with link_desc_*_length and retry. No chain is longer than entries.
+	if ((size_t)n > max)
+		RETURN_ERROR;
+
+	for (int i = 0; i < n; i++)
+		descs[i] = array[(consumer + i) & (entries - 1)];
+
+	// The peer may rewrite the array while we copy, so terminate the copy.
+	descs[n - 1].flags &= ~LINK_DESC_NEXT;
+
+	link_desc_consume(queue, consumer + n);
+
+	return n;
+}
+
+static int link_desc_wait_data(struct link_desc_queue *queue)
+{
+	for (;;) {
+		uint32_t producer =
+			__atomic_load_n(&queue->producer, __ATOMIC_SEQ_CST);
+		if (producer != queue->consumer)
+			return 0;
+
+		__atomic_store_n(&queue->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+		producer = __atomic_load_n(&queue->producer, __ATOMIC_SEQ_CST);
+		if (producer == queue->consumer)
+			futex_wait(&queue->producer, producer);
+		__atomic_store_n(&queue->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+}
+
+static int link_desc_wait_space(struct link_desc_queue *queue,
+								uint32_t entries, size_t n)
+{
+	for (;;) {
+		uint32_t consumer =
+			__atomic_load_n(&queue->consumer, __ATOMIC_SEQ_CST);
+		if (n <= entries - (queue->producer - consumer))
+			return 0;
+
+		__atomic_store_n(&queue->producer_waiting, 1, __ATOMIC_SEQ_CST);
+		consumer = __atomic_load_n(&queue->consumer, __ATOMIC_SEQ_CST);
+		if (n > entries - (queue->producer - consumer))
+			futex_wait(&queue->consumer, consumer);
+		__atomic_store_n(&queue->producer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+}
+
+int link_desc_init(struct portal_link *link)
+{
+	struct link_geometry geometry;
+	if (!link_desc_geometry_valid(link, &geometry))
+		RETURN_ERROR;
+
+	uint32_t entries = geometry.data_limit / (2 * sizeof(struct link_desc));
+	if (entries == 0)
+		RETURN_ERROR;
+
+	struct link_desc_ring *ring =
+		(struct link_desc_ring *)(link->data + geometry.header_offset);
+
+	memset(ring, 0, sizeof(struct link_desc_ring));
+	ring->entries = 1u << (31 - __builtin_clz(entries));
+
+	return 0;
+}
+
+int link_desc_submit(struct portal_link *link, const struct link_desc *chain,
+					 size_t n)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1 || chain == NULL)
+		RETURN_ERROR;
+
+	return link_desc_push(&view.ring->submit, view.submit, view.entries,
+						  chain, n);
+}
+
+int link_desc_reap(struct portal_link *link, struct link_desc *chain,
+				   size_t max)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1 || chain == NULL)
+		RETURN_ERROR;
+
+	return link_desc_pop(&view.ring->complete, view.complete, view.entries,
+						 chain, max);
+}
+
+int link_desc_receive(struct portal_link *link, struct link_desc *chain,
+					  size_t max)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1 || chain == NULL)
+		RETURN_ERROR;
+
+	return link_desc_pop(&view.ring->submit, view.submit, view.entries,
+						 chain, max);
+}
+
+int link_desc_complete(struct portal_link *link, const struct link_desc *chain,
+					   size_t n)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1 || chain == NULL)
+		RETURN_ERROR;
+
+	return link_desc_push(&view.ring->complete, view.complete, view.entries,
+						  chain, n);
+}
+
+int link_desc_reap_length(struct portal_link *link)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1)
+		RETURN_ERROR;
+
+	return link_desc_chain_length(&view.ring->complete, view.complete,
+								  view.entries, view.ring->complete.consumer);
+}
+
+int link_desc_receive_length(struct portal_link *link)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1)
+		RETURN_ERROR;
+
+	return link_desc_chain_length(&view.ring->submit, view.submit,
+								  view.entries, view.ring->submit.consumer);
+}
+
+int link_desc_wait_submit(struct portal_link *link, size_t n)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1 || n == 0 || n > view.entries)
+		RETURN_ERROR;
+
+	return link_desc_wait_space(&view.ring->submit, view.entries, n);
+}
+
+int link_desc_wait_reap(struct portal_link *link)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1)
+		RETURN_ERROR;
+
+	return link_desc_wait_data(&view.ring->complete);
+}
+
+int link_desc_wait_receive(struct portal_link *link)
+{
+	struct link_desc_view view;
+	if (link_desc_view(link, &view) == -1)
+		RETURN_ERROR;
+
+	return link_desc_wait_data(&view.ring->submit);
+}
+
+int link_pool_map(struct link_pool *pool, const char *identifier,
+				  size_t length, size_t buffer_size, int create)
+{
+	if (pool == NULL || identifier == NULL || buffer_size == 0 ||
+		length < buffer_size)
+		RETURN_ERROR;
+
+	length = ALIGN_UP(length, PAGE_SIZE);
+
+	uintptr_t address;
+	if (as_vmem_allocate(CAPABILITY_SELF_AS, &address, length) == -1)
+		RETURN_ERROR;
+
+	struct portal_req portal_req = {
+		.type = PORTAL_REQ_SHARE,
+		.prot = PORTAL_PROT_READ | PORTAL_PROT_WRITE,
+		.length = sizeof(struct portal_req),
+		.share = { .identifier = identifier,
+				   .create = create,
+				   .length = length,
+				   .type = 0 },
+		.morphology = { .addr = address, .length = length }
+	};
+
+	struct portal_resp portal_resp;
+
+	struct syscall_response syscall_response =
+		SYSCALL2(SYSCALL_PORTAL, &portal_req, &portal_resp);
+	if (syscall_response.ret == -1) {
+		as_vmem_free(CAPABILITY_SELF_AS, address, length);
+		RETURN_ERROR;
+	}
+	if (portal_resp.base != address || portal_resp.limit != length)
+		goto unmap;
+
+	pool->base = (void *)address;
+	pool->length = length;
+	pool->buffer_size = buffer_size;
+	pool->bitmap.size = length / buffer_size;
+	pool->bitmap.resizable = 0;
+	pool->bitmap.data = alloc(DIV_ROUNDUP(pool->bitmap.size, 8));
+	if (pool->bitmap.data == NULL)
+		goto unmap;
+
+	return 0;
+
+unmap:
+	as_mem_free(CAPABILITY_SELF_AS, address, length);
+	RETURN_ERROR;
+}
+
+int link_pool_alloc(struct link_pool *pool, uint64_t *offset)
+{
+	if (pool == NULL || offset == NULL)
+		RETURN_ERROR;
+
+	int index;
+	if (bitmap_alloc(&pool->bitmap, &index) == -1)
+		return -1;
+
+	*offset = (uint64_t)index * pool->buffer_size;
+
+	return 0;
+}
+
+int link_pool_free(struct link_pool *pool, uint64_t offset)
+{
+	if (pool == NULL || offset >= pool->length ||
+		offset % pool->buffer_size != 0)
+		RETURN_ERROR;
+
+	return bitmap_free(&pool->bitmap, offset / pool->buffer_size);
+}
+
+void *link_pool_address(struct link_pool *pool, uint64_t offset, size_t length)
+{
+	if (unlikely(pool == NULL || offset >= pool->length ||
+				 length > pool->length - offset))
+		return NULL;
+
+	return pool->base + offset;
+}
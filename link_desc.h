@@ -0,0 +1,87 @@
+#ifndef ARIA_LINK_DESC_H_
+#define ARIA_LINK_DESC_H_
+
+#include <aria/portal.h>
+#include <aria/bitmap.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Scatter-gather descriptor channel over a LINK_VECTOR portal link. Payloads
+ * stay in a buffer pool shared through PORTAL_REQ_SHARE; only (offset,
+ * length) descriptors travel through the link. The driver submits descriptor
+ * chains, the service receives them, works on the buffers in place and hands
+ * ownership back through the completion queue, where the driver reaps them.
+ *
+ * The control block lives at data + header_offset. The submit and complete
+ * descriptor arrays follow each other at data + data_offset, each holding
+ * entries descriptors. A driver must not have more than entries descriptors
+ * outstanding, which a pool of at most entries buffers guarantees. The
+ * geometry and entries are checked against link->length on every call.
+ *
+ * reap and receive fail without consuming anything when the next chain is
+ * longer than max; the *_length functions report the length of the next
+ * chain so the caller can retry with a larger array. A chain is never
+ * longer than entries. A chain running past the published descriptors is
+ * malformed and is dropped.
+ */
+struct link_desc {
+	uint64_t offset;
+	uint32_t length;
+	uint32_t flags;
+};
+
+constexpr uint32_t LINK_DESC_NEXT = 1u << 0;
+constexpr uint32_t LINK_DESC_WRITE = 1u << 1;
+
+struct link_desc_queue {
+	alignas(64) uint32_t producer;
+	uint32_t producer_waiting;
+
+	alignas(64) uint32_t consumer;
+	uint32_t consumer_waiting;
+};
+
+struct link_desc_ring {
+	struct link_desc_queue submit;
+	struct link_desc_queue complete;
+
+	uint32_t entries;
+};
+
+struct link_pool {
+	void *base;
+	size_t length;
+	size_t buffer_size;
+
+	struct bitmap bitmap;
+};
+
+int link_desc_init(struct portal_link *link);
+
+/* Driver side */
+int link_desc_submit(struct portal_link *link, const struct link_desc *chain,
+					 size_t n);
+int link_desc_reap(struct portal_link *link, struct link_desc *chain,
+				   size_t max);
+int link_desc_wait_submit(struct portal_link *link, size_t n);
+int link_desc_reap_length(struct portal_link *link);
+int link_desc_wait_reap(struct portal_link *link);
+
+/* Service side */
+int link_desc_receive(struct portal_link *link, struct link_desc *chain,
+					  size_t max);
+int link_desc_complete(struct portal_link *link, const struct link_desc *chain,
+					   size_t n);
+int link_desc_receive_length(struct portal_link *link);
+int link_desc_wait_receive(struct portal_link *link);
+
+int link_pool_map(struct link_pool *pool, const char *identifier,
+				  size_t length, size_t buffer_size, int create);
+int link_pool_alloc(struct link_pool *pool, uint64_t *offset);
+int link_pool_free(struct link_pool *pool, uint64_t offset);
+void *link_pool_address(struct link_pool *pool, uint64_t offset,
+						size_t length);
+
+#endif
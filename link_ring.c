@@ -0,0 +1,277 @@
+#include <aria/link_ring.h>
+#include <aria/compiler.h>
+#include <aria/string.h>
+#include <aria/sched.h>
+#include <aria/debug.h>
+
+static inline struct link_ring *
+link_ring_header(struct portal_link *link,
+				 const struct link_geometry *geometry)
+{
+	return (struct link_ring *)(link->data + geometry->header_offset);
+}
+
+static inline char *link_ring_data(struct portal_link *link,
+								   const struct link_geometry *geometry)
+{
+	return link->data + geometry->data_offset;
+}
+
+static inline bool link_ring_valid(struct portal_link *link)
+{
+	return link != NULL && link->magic == LINK_CIRCULAR_MAGIC;
+}
+
+static inline bool link_ring_geometry_valid(struct portal_link *link,
+											struct link_geometry *geometry)
+{
+	link_geometry_read(link, geometry);
+
+	if (!link_geometry_valid(geometry))
+		return false;
+	if (geometry->header_limit < sizeof(struct link_ring))
+		return false;
+	if (geometry->data_limit < LINK_RING_ALIGN * 2 ||
+		(geometry->data_limit & (geometry->data_limit - 1)) != 0)
+		return false;
+	if ((geometry->header_offset | geometry->data_offset) &
+		(LINK_RING_ALIGN - 1))
+		return false;
+
+	return true;
+}
+
+// Bytes needed to place a record of total size at producer, including the
+// padding record used to skip the tail of the ring when it does not fit.
+static inline uint32_t link_ring_needed(struct link_ring_endpoint *endpoint,
+										uint32_t producer, uint32_t total)
+{
+	uint32_t position = producer & (endpoint->data_limit - 1);
+	uint32_t contiguous = endpoint->data_limit - position;
+
+	return (total > contiguous) ? contiguous + total : total;
+}
+
+// A consumer index that claims more than a full ring in flight is bogus and
+// must not make the free space underflow.
+static inline bool link_ring_fits(struct link_ring_endpoint *endpoint,
+								  uint32_t producer, uint32_t consumer,
+								  uint32_t total)
+{
+	uint32_t used = producer - consumer;
+	if (used > endpoint->data_limit)
+		return false;
+
+	return endpoint->data_limit - used >=
+		   link_ring_needed(endpoint, producer, total);
+}
+
+int link_ring_init(struct portal_link *link)
+{
+	struct link_geometry geometry;
+	if (!link_ring_valid(link) || !link_ring_geometry_valid(link, &geometry))
+		RETURN_ERROR;
+
+	memset(link_ring_header(link, &geometry), 0, sizeof(struct link_ring));
+
+	return 0;
+}
+
+int link_ring_attach(struct link_ring_endpoint *endpoint,
+					 struct portal_link *link)
+{
+	struct link_geometry geometry;
+	if (endpoint == NULL || !link_ring_valid(link) ||
+		!link_ring_geometry_valid(link, &geometry))
+		RETURN_ERROR;
+
+	endpoint->ring = link_ring_header(link, &geometry);
+	endpoint->data = link_ring_data(link, &geometry);
+	endpoint->data_limit = geometry.data_limit;
+	endpoint->reserved = 0;
+	endpoint->pending = 0;
+
+	return 0;
+}
+
+void *link_ring_reserve(struct link_ring_endpoint *endpoint, size_t length)
+{
+	if (unlikely(endpoint == NULL || length > LINK_RING_MAX_LENGTH(endpoint)))
+		return NULL;
+
+	struct link_ring *ring = endpoint->ring;
+	uint32_t total = LINK_RING_RECORD_SIZE(length);
+
+	uint32_t producer = ring->producer;
+	uint32_t consumer = __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+	if (!link_ring_fits(endpoint, producer, consumer, total))
+		return NULL;
+
+	char *data = endpoint->data;
+	uint32_t position = producer & (endpoint->data_limit - 1);
+	uint32_t needed = link_ring_needed(endpoint, producer, total);
+
+	if (needed != total) {
+		((struct link_ring_record *)(data + position))->length = LINK_RING_PAD;
+		position = 0;
+	}
+
+	struct link_ring_record *record = (void *)(data + position);
+	record->length = length;
+	record->flags = 0;
+
+	endpoint->reserved = needed;
+
+	return record + 1;
+}
+
+int link_ring_commit(struct link_ring_endpoint *endpoint)
+{
+	if (unlikely(endpoint == NULL || endpoint->reserved == 0))
+		RETURN_ERROR;
+
+	struct link_ring *ring = endpoint->ring;
+
+	__atomic_store_n(&ring->producer, ring->producer + endpoint->reserved,
+					 __ATOMIC_SEQ_CST);
+	endpoint->reserved = 0;
+
+	if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST))
+		futex_wake(&ring->producer, INT32_MAX);
+
+	return 0;
+}
+
+int link_ring_write(struct link_ring_endpoint *endpoint, const void *data,
+					size_t length)
+{
+	void *buffer = link_ring_reserve(endpoint, length);
+	if (buffer == NULL)
+		return -1;
+
+	memcpy(buffer, data, length);
+
+	return link_ring_commit(endpoint);
+}
+
+int link_ring_wait_space(struct link_ring_endpoint *endpoint, size_t length)
+{
+	if (endpoint == NULL || length > LINK_RING_MAX_LENGTH(endpoint))
+		RETURN_ERROR;
+
+	struct link_ring *ring = endpoint->ring;
+	uint32_t total = LINK_RING_RECORD_SIZE(length);
+
+	for (;;) {
+		uint32_t consumer = __atomic_load_n(&ring->consumer, __ATOMIC_SEQ_CST);
+		if (link_ring_fits(endpoint, ring->producer, consumer, total))
+			return 0;
+
+		__atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+		consumer = __atomic_load_n(&ring->consumer, __ATOMIC_SEQ_CST);
+		if (!link_ring_fits(endpoint, ring->producer, consumer, total))
+			futex_wait(&ring->consumer, consumer);
+		__atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+}
+
+/*
+ * The peer is not trusted: a record must lie within the published bytes
+ * and within the data area, and a padding marker is only honoured when the
+ * record after it really did not fit before the wrap. Lengths are read once
+ * so the peer cannot change them between the checks and the use.
+ */
+void *link_ring_peek(struct link_ring_endpoint *endpoint, size_t *length)
+{
+	if (unlikely(endpoint == NULL || length == NULL))
+		return NULL;
+
+	struct link_ring *ring = endpoint->ring;
+	uint32_t consumer = ring->consumer;
+	uint32_t producer = __atomic_load_n(&ring->producer, __ATOMIC_ACQUIRE);
+	uint32_t available = producer - consumer;
+	if (available == 0 || unlikely(available > endpoint->data_limit))
+		return NULL;
+
+	char *data = endpoint->data;
+	uint32_t position = consumer & (endpoint->data_limit - 1);
+	uint32_t contiguous = endpoint->data_limit - position;
+	uint32_t skip = 0;
+
+	struct link_ring_record *record = (void *)(data + position);
+	uint32_t record_length = __atomic_load_n(&record->length, __ATOMIC_RELAXED);
+	if (record_length == LINK_RING_PAD) {
+		skip = contiguous;
+		record = (void *)data;
+		record_length = __atomic_load_n(&record->length, __ATOMIC_RELAXED);
+	}
+
+	if (unlikely(record_length > LINK_RING_MAX_LENGTH(endpoint)))
+		return NULL;
+
+	uint32_t size = LINK_RING_RECORD_SIZE(record_length);
+	if (unlikely(skip ? size <= contiguous : size > contiguous))
+		return NULL;
+	if (unlikely(skip + size > available))
+		return NULL;
+
+	*length = record_length;
+	endpoint->pending = skip + size;
+
+	return record + 1;
+}
+
+int link_ring_release(struct link_ring_endpoint *endpoint)
+{
+	if (unlikely(endpoint == NULL || endpoint->pending == 0))
+		RETURN_ERROR;
+
+	struct link_ring *ring = endpoint->ring;
+
+	__atomic_store_n(&ring->consumer, ring->consumer + endpoint->pending,
+					 __ATOMIC_SEQ_CST);
+	endpoint->pending = 0;
+
+	if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST))
+		futex_wake(&ring->consumer, INT32_MAX);
+
+	return 0;
+}
+
+int link_ring_read(struct link_ring_endpoint *endpoint, void *data,
+				   size_t length)
+{
+	size_t record_length;
+	void *record = link_ring_peek(endpoint, &record_length);
+	if (record == NULL)
+		return -1;
+	if (record_length > length)
+		RETURN_ERROR;
+
+	memcpy(data, record, record_length);
+
+	if (link_ring_release(endpoint) == -1)
+		return -1;
+
+	return record_length;
+}
+
+int link_ring_wait_data(struct link_ring_endpoint *endpoint)
+{
+	if (endpoint == NULL)
+		RETURN_ERROR;
+
+	struct link_ring *ring = endpoint->ring;
+
+	for (;;) {
+		uint32_t producer = __atomic_load_n(&ring->producer, __ATOMIC_SEQ_CST);
+		if (producer != ring->consumer)
+			return 0;
+
+		__atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+		producer = __atomic_load_n(&ring->producer, __ATOMIC_SEQ_CST);
+		if (producer == ring->consumer)
+			futex_wait(&ring->producer, producer);
+		__atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+}
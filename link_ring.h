@@ -0,0 +1,83 @@
+#ifndef ARIA_LINK_RING_H_
+#define ARIA_LINK_RING_H_
+
+#include <aria/portal.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Single-producer/single-consumer message ring over a LINK_CIRCULAR portal
+ * link. The control block lives at data + header_offset and the byte ring at
+ * data + data_offset (data_limit bytes, a power of two). Neither side takes
+ * link->lock, so a descheduled peer can never stall the other one.
+ *
+ * producer and consumer are free-running byte indices; their difference is
+ * the number of bytes in flight, which stays correct across 32-bit wrap.
+ * Each side sleeps on the other side's index with the futex syscall, and
+ * only issues a wake when the peer has flagged itself as waiting.
+ *
+ * The peer can rewrite anything in the portal page, so each side works
+ * through a process-local endpoint holding the ring geometry captured and
+ * checked against link->length at attach time, and its own in-progress
+ * reservation or peeked record.
+ */
+struct link_ring {
+	alignas(64) uint32_t producer;
+	uint32_t producer_waiting;
+
+	alignas(64) uint32_t consumer;
+	uint32_t consumer_waiting;
+};
+
+struct link_ring_endpoint {
+	struct link_ring *ring;
+	char *data;
+	uint32_t data_limit;
+
+	/* Producer: bytes reserved but not committed yet */
+	uint32_t reserved;
+	/* Consumer: bytes taken by the peeked record, including padding */
+	uint32_t pending;
+};
+
+struct link_ring_record {
+	uint32_t length;
+	uint32_t flags;
+};
+
+constexpr uint32_t LINK_RING_PAD = UINT32_MAX;
+constexpr uint32_t LINK_RING_ALIGN = 8;
+
+#define LINK_RING_RECORD_SIZE(LENGTH)                                     \
+	((sizeof(struct link_ring_record) + (LENGTH) + LINK_RING_ALIGN - 1) & \
+	 ~(size_t)(LINK_RING_ALIGN - 1))
+
+/*
+ * Largest message the ring accepts. Keeping records within half the ring
+ * guarantees that any of them fits into an empty ring, wherever the
+ * indices are, even when it has to skip the tail.
+ */
+#define LINK_RING_MAX_LENGTH(LINK)                             \
+	((LINK)->data_limit / 2 - sizeof(struct link_ring_record))
+
+int link_ring_init(struct portal_link *link);
+int link_ring_attach(struct link_ring_endpoint *endpoint,
+					 struct portal_link *link);
+
+/* Producer side: reserve space, fill it in place, then publish it. */
+void *link_ring_reserve(struct link_ring_endpoint *endpoint, size_t length);
+int link_ring_commit(struct link_ring_endpoint *endpoint);
+int link_ring_write(struct link_ring_endpoint *endpoint, const void *data,
+					size_t length);
+int link_ring_wait_space(struct link_ring_endpoint *endpoint, size_t length);
+
+/* Consumer side: look at the next message in place, then release it. */
+void *link_ring_peek(struct link_ring_endpoint *endpoint, size_t *length);
+int link_ring_release(struct link_ring_endpoint *endpoint);
+int link_ring_read(struct link_ring_endpoint *endpoint, void *data,
+				   size_t length);
+int link_ring_wait_data(struct link_ring_endpoint *endpoint);
+
+#endif
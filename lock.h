@@ -2,12 +2,24 @@
 #define ARIA_LOCK_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct spinlock {
 	char lock;
 	int interrupts;
 };
 
+/*
+ * Reader-writer spinlock. The top bit marks a writer, the remaining bits
+ * count readers. A writer claims the top bit first, which keeps new readers
+ * out, and then waits for the readers already inside to leave.
+ */
+struct rwlock {
+	uint32_t state;
+};
+
+#define RWLOCK_WRITER (1u << 31)
+
 static inline void raw_spinlock(void *lock)
 {
 	while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE))
@@ -29,4 +41,36 @@ static inline void spinrelease(struct spinlock *spinlock)
 	raw_spinrelease(&spinlock->lock);
 }
 
+static inline void rwlock_read(struct rwlock *rwlock)
+{
+	for (;;) {
+		uint32_t state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+		if (!(state & RWLOCK_WRITER) &&
+			__atomic_compare_exchange_n(&rwlock->state, &state, state + 1,
+										false, __ATOMIC_ACQUIRE,
+										__ATOMIC_RELAXED))
+			return;
+		__builtin_ia32_pause();
+	}
+}
+
+static inline void rwlock_read_release(struct rwlock *rwlock)
+{
+	__atomic_sub_fetch(&rwlock->state, 1, __ATOMIC_RELEASE);
+}
+
+static inline void rwlock_write(struct rwlock *rwlock)
+{
+	while (__atomic_fetch_or(&rwlock->state, RWLOCK_WRITER, __ATOMIC_ACQUIRE) &
+		   RWLOCK_WRITER)
+		__builtin_ia32_pause();
+	while (__atomic_load_n(&rwlock->state, __ATOMIC_ACQUIRE) != RWLOCK_WRITER)
+		__builtin_ia32_pause();
+}
+
+static inline void rwlock_write_release(struct rwlock *rwlock)
+{
+	__atomic_and_fetch(&rwlock->state, ~RWLOCK_WRITER, __ATOMIC_RELEASE);
+}
+
 #endif
@@ -35,25 +35,68 @@ static struct pairing_heap_node *meld(struct pairing_heap_node *a,
 	return b;
 }
 
+/*
+ * Two-pass pairing: meld the children in pairs from left to right, then meld
+ * the results from right to left. The first pass builds the list of pairs
+ * in reverse, so the second pass simply walks it.
+ */
 static struct pairing_heap_node *merge_pairs(struct pairing_heap_node *node,
 											 pairing_heap_cmp_func *cmp)
 {
-	if (!node || !node->next) {
-		return node;
+	if (!node) {
+		return NULL;
 	}
 
-	struct pairing_heap_node *next = node->next;
-	node->next = NULL;
+	struct pairing_heap_node *pairs = NULL;
+
+	while (node) {
+		struct pairing_heap_node *a = node;
+		struct pairing_heap_node *b = node->next;
+
+		node = b ? b->next : NULL;
+		a->next = NULL;
+
+		if (b) {
+			b->next = NULL;
+			a = meld(a, b, cmp);
+		}
+
+		a->next = pairs;
+		pairs = a;
+	}
 
-	struct pairing_heap_node *merged = meld(node, next, cmp);
-	while (next->next) {
-		next = next->next;
-		merged = meld(merged, next, cmp);
+	struct pairing_heap_node *merged = pairs;
+	pairs = pairs->next;
+	merged->next = NULL;
+
+	while (pairs) {
+		struct pairing_heap_node *next = pairs->next;
+		pairs->next = NULL;
+		merged = meld(merged, pairs, cmp);
+		pairs = next;
 	}
 
+	merged->prev = NULL;
 	return merged;
 }
 
+/* Detach node and its subtree from wherever it hangs below the root */
+static void cut(struct pairing_heap_node *node)
+{
+	if (node->prev->child == node) {
+		node->prev->child = node->next;
+	} else {
+		node->prev->next = node->next;
+	}
+
+	if (node->next) {
+		node->next->prev = node->prev;
+	}
+
+	node->next = NULL;
+	node->prev = NULL;
+}
+
 void pairing_heap_init(struct pairing_heap *heap, pairing_heap_cmp_func *cmp)
 {
 	heap->size = 0;
@@ -78,16 +121,7 @@ void pairing_heap_remove(struct pairing_heap *heap,
 
 	heap->size--;
 
-	/* Unlink the node */
-	if (node->prev->child == node) {
-		node->prev->child = node->next;
-	} else {
-		node->prev->next = node->next;
-	}
-
-	if (node->next) {
-		node->next->prev = node->prev;
-	}
+	cut(node);
 
 	if (node->child) {
 		node->child->prev = NULL;
@@ -95,11 +129,79 @@ void pairing_heap_remove(struct pairing_heap *heap,
 			meld(heap->root, merge_pairs(node->child, heap->cmp), heap->cmp);
 	}
 
-	node->next = NULL;
-	node->prev = NULL;
 	node->child = NULL;
 }
 
+void pairing_heap_decrease_key(struct pairing_heap *heap,
+							   struct pairing_heap_node *node)
+{
+	if (heap->root == node) {
+		return;
+	}
+
+	/* Only the link to the parent can be out of order, so cut it there */
+	cut(node);
+	heap->root = meld(heap->root, node, heap->cmp);
+}
+
+void pairing_heap_meld(struct pairing_heap *heap, struct pairing_heap *other)
+{
+	heap->root = meld(heap->root, other->root, heap->cmp);
+	heap->size += other->size;
+
+	other->root = NULL;
+	other->size = 0;
+}
+
+void pairing_heap_insert_many(struct pairing_heap *heap,
+							  struct pairing_heap_node **nodes, size_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	/*
+	 * Multipass pairing: keep a FIFO of trees threaded through next, meld
+	 * the two at the front and append the result until one tree is left.
+	 * This builds the heap in O(n) with a shallow, balanced shape.
+	 */
+	struct pairing_heap_node *head = nodes[0];
+	struct pairing_heap_node *tail = nodes[0];
+
+	for (size_t i = 0; i < n; i++) {
+		nodes[i]->child = NULL;
+		nodes[i]->prev = NULL;
+		nodes[i]->next = NULL;
+
+		if (i > 0) {
+			tail->next = nodes[i];
+			tail = nodes[i];
+		}
+	}
+
+	while (head != tail) {
+		struct pairing_heap_node *a = head;
+		struct pairing_heap_node *b = head->next;
+
+		head = b->next;
+		a->next = NULL;
+		b->next = NULL;
+
+		struct pairing_heap_node *merged = meld(a, b, heap->cmp);
+
+		if (head) {
+			tail->next = merged;
+			tail = merged;
+		} else {
+			head = merged;
+			tail = merged;
+		}
+	}
+
+	heap->root = meld(heap->root, head, heap->cmp);
+	heap->size += n;
+}
+
 struct pairing_heap_node *pairing_heap_top(struct pairing_heap *heap)
 {
 	return heap->root;
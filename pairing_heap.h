@@ -37,6 +37,23 @@ struct pairing_heap_node *pairing_heap_pop(struct pairing_heap *heap);
 void pairing_heap_remove(struct pairing_heap *heap,
 						 struct pairing_heap_node *node);
 
+/*
+ * Restore the heap after node's key changed so that it compares closer to
+ * the top (smaller for a min heap). O(1) amortized.
+ */
+void pairing_heap_decrease_key(struct pairing_heap *heap,
+							   struct pairing_heap_node *node);
+
+/*
+ * Move every node of other into heap, leaving other empty. Both heaps must
+ * use the same comparison.
+ */
+void pairing_heap_meld(struct pairing_heap *heap, struct pairing_heap *other);
+
+/* Insert n nodes at once, pairing them up in O(n) */
+void pairing_heap_insert_many(struct pairing_heap *heap,
+							  struct pairing_heap_node **nodes, size_t n);
+
 /* Get whatever is at the top of the heap without removing it */
 struct pairing_heap_node *pairing_heap_top(struct pairing_heap *heap);
 
@@ -44,6 +44,46 @@ constexpr uint32_t LINK_CIRCULAR_MAGIC = 0x9E810F7F;
 constexpr uint32_t LINK_VECTOR_MAGIC = 0xEF8647C0;
 constexpr uint32_t LINK_RAW_MAGIC = 0xFF6C7D34;
 
+/*
+ * Copy of the geometry of a link. The link sits in memory shared with the
+ * peer, so its geometry is read once, checked, and only the copy is used.
+ */
+struct link_geometry {
+	uint32_t length;
+	uint32_t header_offset;
+	uint32_t header_limit;
+	uint32_t data_offset;
+	uint32_t data_limit;
+};
+
+static inline void link_geometry_read(struct portal_link *link,
+									  struct link_geometry *geometry)
+{
+	const volatile struct portal_link *shared = link;
+
+	geometry->length = shared->length;
+	geometry->header_offset = shared->header_offset;
+	geometry->header_limit = shared->header_limit;
+	geometry->data_offset = shared->data_offset;
+	geometry->data_limit = shared->data_limit;
+}
+
+/* Header and data regions lie within the link's data and do not overlap */
+static inline bool link_geometry_valid(const struct link_geometry *geometry)
+{
+	if (geometry->header_offset > geometry->length ||
+		geometry->header_limit > geometry->length - geometry->header_offset)
+		return false;
+	if (geometry->data_offset > geometry->length ||
+		geometry->data_limit > geometry->length - geometry->data_offset)
+		return false;
+
+	return geometry->header_offset + geometry->header_limit <=
+			   geometry->data_offset ||
+		   geometry->data_offset + geometry->data_limit <=
+			   geometry->header_offset;
+}
+
 #define LINK_META(LINK) ({ (LINK)->data + header->offset; })
 
 #define OPERATE_LINK(LINK, CLASS, OPERATION)                                \
@@ -0,0 +1,254 @@
+#include <aria/random.h>
+#include <aria/lock.h>
+#include <aria/time.h>
+#include <aria/string.h>
+
+#define CHACHA_ROUNDS 20
+
+/* Intel suggests retrying rdrand 10 times, rdseed may need more patience */
+#define RDRAND_RETRIES 10
+#define RDSEED_RETRIES 64
+
+#define CPUID_RDRAND (1u << 30)
+#define CPUID_RDSEED (1u << 18)
+
+static struct random_state random_global;
+static struct spinlock random_lock;
+static bool random_seeded;
+
+#define ROTL32(X, N) (((X) << (N)) | ((X) >> (32 - (N))))
+
+#define QUARTER_ROUND(A, B, C, D)            \
+	({                                       \
+		A += B;                              \
+		D = ROTL32(D ^ A, 16);               \
+		C += D;                              \
+		B = ROTL32(B ^ C, 12);               \
+		A += B;                              \
+		D = ROTL32(D ^ A, 8);                \
+		C += D;                              \
+		B = ROTL32(B ^ C, 7);                \
+	})
+
+static void chacha_block(const uint32_t key[8], uint64_t counter,
+						 uint32_t out[16])
+{
+	uint32_t input[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+						   key[0],	   key[1],	   key[2],	   key[3],
+						   key[4],	   key[5],	   key[6],	   key[7],
+						   (uint32_t)counter,
+						   (uint32_t)(counter >> 32),
+						   0,
+						   0 };
+
+	uint32_t x[16];
+	memcpy(x, input, sizeof(x));
+
+	for (int i = 0; i < CHACHA_ROUNDS; i += 2) {
+		QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+		QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+		QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+		QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+		QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+		QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+		QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+		QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+	}
+
+	for (int i = 0; i < 16; i++)
+		out[i] = x[i] + input[i];
+}
+
+static void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx)
+{
+	uint32_t edx;
+	__asm__ volatile("cpuid"
+					 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(edx)
+					 : "a"(leaf), "c"(0));
+}
+
+/* Bit 0 for rdrand and bit 1 for rdseed, probed once */
+static int random_hardware(void)
+{
+	static int features = -1;
+
+	int ret = __atomic_load_n(&features, __ATOMIC_RELAXED);
+	if (ret != -1)
+		return ret;
+
+	uint32_t max_leaf, eax, ebx, ecx;
+	ret = 0;
+
+	cpuid(0, &max_leaf, &ebx, &ecx);
+
+	cpuid(1, &eax, &ebx, &ecx);
+	if (ecx & CPUID_RDRAND)
+		ret |= 1;
+
+	if (max_leaf >= 7) {
+		cpuid(7, &eax, &ebx, &ecx);
+		if (ebx & CPUID_RDSEED)
+			ret |= 2;
+	}
+
+	__atomic_store_n(&features, ret, __ATOMIC_RELAXED);
+
+	return ret;
+}
+
+static int rdseed(uint64_t *ret)
+{
+	for (int i = 0; i < RDSEED_RETRIES; i++) {
+		unsigned char ok;
+		__asm__ volatile("rdseed %0; setc %1" : "=r"(*ret), "=qm"(ok));
+		if (ok)
+			return 0;
+		__builtin_ia32_pause();
+	}
+
+	return -1;
+}
+
+static int rdrand(uint64_t *ret)
+{
+	for (int i = 0; i < RDRAND_RETRIES; i++) {
+		unsigned char ok;
+		__asm__ volatile("rdrand %0; setc %1" : "=r"(*ret), "=qm"(ok));
+		if (ok)
+			return 0;
+	}
+
+	return -1;
+}
+
+int random_entropy(void *buffer, size_t length)
+{
+	int features = random_hardware();
+	uint8_t *out = buffer;
+
+	while (length) {
+		uint64_t word;
+
+		if (!((features & 2) && rdseed(&word) == 0) &&
+			!((features & 1) && rdrand(&word) == 0))
+			return -1;
+
+		size_t n = length < sizeof(word) ? length : sizeof(word);
+		memcpy(out, &word, n);
+		out += n;
+		length -= n;
+	}
+
+	return 0;
+}
+
+static int random_reseed(struct random_state *state)
+{
+	uint32_t entropy[8];
+	int ret = random_entropy(entropy, sizeof(entropy));
+
+	if (ret == -1) {
+		for (int i = 0; i < 8; i++)
+			entropy[i] = tsc_read() * 0x9e3779b97f4a7c15ull >> 32;
+	}
+
+	for (int i = 0; i < 8; i++)
+		state->key[i] ^= entropy[i];
+
+	memset(entropy, 0, sizeof(entropy));
+	state->reseed = RANDOM_RESEED_BLOCKS;
+
+	return ret;
+}
+
+/* Generate the next blocks and take the new key from the start of them */
+static void random_refill(struct random_state *state)
+{
+	if (state->reseed < RANDOM_BLOCKS)
+		random_reseed(state);
+	state->reseed -= RANDOM_BLOCKS;
+
+	for (int i = 0; i < RANDOM_BLOCKS; i++)
+		chacha_block(state->key, state->counter++, &state->buffer[i * 16]);
+
+	memcpy(state->key, state->buffer, sizeof(state->key));
+	memset(state->buffer, 0, sizeof(state->key));
+	state->index = 8;
+}
+
+int random_state_init(struct random_state *state)
+{
+	memset(state, 0, sizeof(*state));
+
+	int ret = random_reseed(state);
+	state->index = RANDOM_BLOCKS * 16;
+
+	return ret;
+}
+
+uint64_t random_state_u64(struct random_state *state)
+{
+	if (state->index + 2 > RANDOM_BLOCKS * 16)
+		random_refill(state);
+
+	uint32_t *word = &state->buffer[state->index];
+	uint64_t ret = word[0] | ((uint64_t)word[1] << 32);
+
+	/* Served output is erased so it cannot be recovered from the state */
+	word[0] = 0;
+	word[1] = 0;
+	state->index += 2;
+
+	return ret;
+}
+
+/*
+ * Lemire's method: the high half of random * limit is uniform once the
+ * few low halves that would over-represent some results are rejected.
+ */
+uint64_t random_state_range(struct random_state *state, uint64_t limit)
+{
+	if (limit == 0)
+		return 0;
+
+	unsigned __int128 product =
+		(unsigned __int128)random_state_u64(state) * limit;
+
+	if ((uint64_t)product < limit) {
+		uint64_t threshold = -limit % limit;
+		while ((uint64_t)product < threshold)
+			product = (unsigned __int128)random_state_u64(state) * limit;
+	}
+
+	return product >> 64;
+}
+
+static struct random_state *random_acquire(void)
+{
+	spinlock(&random_lock);
+
+	if (!random_seeded) {
+		random_state_init(&random_global);
+		random_seeded = true;
+	}
+
+	return &random_global;
+}
+
+uint64_t random_u64(void)
+{
+	uint64_t ret = random_state_u64(random_acquire());
+
+	spinrelease(&random_lock);
+
+	return ret;
+}
+
+uint64_t random_range(uint64_t limit)
+{
+	uint64_t ret = random_state_range(random_acquire(), limit);
+
+	spinrelease(&random_lock);
+
+	return ret;
+}
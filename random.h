@@ -0,0 +1,46 @@
+#ifndef ARIA_RANDOM_H_
+#define ARIA_RANDOM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Random numbers from a ChaCha20 keystream keyed with hardware entropy.
+ * Each refill produces RANDOM_BLOCKS blocks; the first 32 bytes replace the
+ * key and are never handed out, so a compromised state does not reveal
+ * earlier output. The key is mixed with fresh entropy again every
+ * RANDOM_RESEED_BLOCKS blocks.
+ */
+#define RANDOM_BLOCKS 4
+#define RANDOM_RESEED_BLOCKS (1 << 16)
+
+struct random_state {
+	uint32_t key[8];
+	uint64_t counter;
+	uint64_t reseed;
+	size_t index;
+	uint32_t buffer[RANDOM_BLOCKS * 16];
+};
+
+/*
+ * Fill buffer from rdseed, or from rdrand where rdseed is unavailable or
+ * keeps failing. Returns -1 if the hardware produced no entropy.
+ */
+int random_entropy(void *buffer, size_t length);
+
+/*
+ * Returns -1 if no hardware entropy was available, in which case the state
+ * is seeded from the TSC alone and must not be used for secrets.
+ */
+int random_state_init(struct random_state *state);
+
+uint64_t random_state_u64(struct random_state *state);
+
+/* Uniform in [0, limit), without modulo bias. Returns 0 if limit is 0 */
+uint64_t random_state_range(struct random_state *state, uint64_t limit);
+
+/* Same as above on a shared, lazily seeded state */
+uint64_t random_u64(void);
+uint64_t random_range(uint64_t limit);
+
+#endif
@@ -33,171 +33,293 @@ out_pnp:                                          \
 		ret;                                      \
 	})
 
+/*
+ * Augmented trees keep a per-node summary of their subtree (e.g. the largest
+ * interval end below a node). AUGMENT(NODE) recomputes NODE's summary from
+ * NODE and its children; it is called for both nodes a rotation moves and,
+ * through RB_AUGMENT_PROPAGATE, on the path from a changed node to the root.
+ * The plain macros use RB_AUGMENT_NONE.
+ */
+#define RB_AUGMENT_NONE(NODE) ((void)(NODE))
+
+#define RB_AUGMENT_PROPAGATE(NODE, AUGMENT)                  \
+	({                                                       \
+		for (__typeof__(NODE) _rap_node = (NODE); _rap_node; \
+			 _rap_node = _rap_node->parent)                  \
+			AUGMENT(_rap_node);                              \
+	})
+
+#define RB_TRANSPLANT(ROOT, NODE, REPLACEMENT)                 \
+	({                                                         \
+		__typeof__(NODE) _rt_node = (NODE);                    \
+		__typeof__(NODE) _rt_replacement = (REPLACEMENT);      \
+		*RB_PARENT_NODE_PTR(ROOT, _rt_node) = _rt_replacement; \
+		if (_rt_replacement)                                   \
+			_rt_replacement->parent = _rt_node->parent;        \
+	})
+
 //	RIGHT ROTATION ON NODE:
 //		SET THE LEFT CHILD OF NODE NODE TO BE THE ROOT OF THE SUB-TREE
 //		MAKE THE RIGHT CHILD OF THE ROOT OF THE SUB-TREE EQUAL TO THE NODE
 //		MAKE THE LEFT CHILD OF NODE EQUAL TO THE PREVIOUS RIGHT CHILD OF THE SUB-TREE
 
-#define RB_ROTATE_RIGHT(ROOT, NODE)                                     \
-	({                                                                  \
-		__label__ out_rr;                                               \
-		int ret = -1;                                                   \
-		ret = 0;                                                        \
-		__typeof__(NODE) *root_parent = RB_PARENT_NODE_PTR(ROOT, NODE); \
-		if (root_parent == NULL)                                        \
-			goto out_rr;                                                \
-		if ((NODE)->left == NULL)                                       \
-			goto out_rr;                                                \
-		*root_parent = (NODE)->left;                                    \
-		__typeof__(NODE) tmp = (*root_parent)->right;                   \
-		(*root_parent)->parent = (NODE)->parent;                        \
-		(NODE)->parent = (*root_parent);                                \
-		if (tmp)                                                        \
-			tmp->parent = (NODE);                                       \
-		(*root_parent)->right = (NODE);                                 \
-		(NODE)->left = tmp;                                             \
-out_rr:                                                                 \
-		ret;                                                            \
+#define RB_ROTATE_RIGHT_AUGMENTED(ROOT, NODE, AUGMENT)                      \
+	({                                                                      \
+		__label__ out_rr;                                                   \
+		int ret = -1;                                                       \
+		__typeof__(NODE) _rr_node = (NODE);                                 \
+		__typeof__(NODE) *root_parent = RB_PARENT_NODE_PTR(ROOT, _rr_node); \
+		if (root_parent == NULL)                                            \
+			goto out_rr;                                                    \
+		if (_rr_node->left == NULL)                                         \
+			goto out_rr;                                                    \
+		*root_parent = _rr_node->left;                                      \
+		__typeof__(NODE) tmp = (*root_parent)->right;                       \
+		(*root_parent)->parent = _rr_node->parent;                          \
+		_rr_node->parent = (*root_parent);                                  \
+		if (tmp)                                                            \
+			tmp->parent = _rr_node;                                         \
+		(*root_parent)->right = _rr_node;                                   \
+		_rr_node->left = tmp;                                               \
+		AUGMENT(_rr_node);                                                  \
+		AUGMENT(_rr_node->parent);                                          \
+		ret = 0;                                                            \
+out_rr:                                                                     \
+		ret;                                                                \
 	})
 
+#define RB_ROTATE_RIGHT(ROOT, NODE)                        \
+	RB_ROTATE_RIGHT_AUGMENTED(ROOT, NODE, RB_AUGMENT_NONE)
+
 //	LEFT ROTATION ON NODE:
 //		SET THE RIGHT CHILD OF NODE TO BE THE ROOT OF THE SUB-TREE
 //		SET THE LEFT CHILD OF THE ROOT OF THE SUB-TREE EQUAL TO NODE
 //		SET THE RIGHT CHILD OF NODE EQUAL TO THE PREVIOUS LEFT CHILD OF THE ROOT OF THE SUB-TREE
 
-#define RB_ROTATE_LEFT(ROOT, NODE)                                      \
-	({                                                                  \
-		__label__ out_rl;                                               \
-		int ret = -1;                                                   \
-		ret = 0;                                                        \
-		__typeof__(NODE) *root_parent = RB_PARENT_NODE_PTR(ROOT, NODE); \
-		if (root_parent == NULL)                                        \
-			goto out_rl;                                                \
-		if ((NODE)->right == NULL)                                      \
-			goto out_rl;                                                \
-		*root_parent = (NODE)->right;                                   \
-		__typeof__(NODE) tmp = (*root_parent)->left;                    \
-		(*root_parent)->parent = (NODE)->parent;                        \
-		(NODE)->parent = (*root_parent);                                \
-		if (tmp)                                                        \
-			tmp->parent = (NODE);                                       \
-		(*root_parent)->left = (NODE);                                  \
-		(NODE)->right = tmp;                                            \
-out_rl:                                                                 \
-		ret;                                                            \
+#define RB_ROTATE_LEFT_AUGMENTED(ROOT, NODE, AUGMENT)                       \
+	({                                                                      \
+		__label__ out_rl;                                                   \
+		int ret = -1;                                                       \
+		__typeof__(NODE) _rl_node = (NODE);                                 \
+		__typeof__(NODE) *root_parent = RB_PARENT_NODE_PTR(ROOT, _rl_node); \
+		if (root_parent == NULL)                                            \
+			goto out_rl;                                                    \
+		if (_rl_node->right == NULL)                                        \
+			goto out_rl;                                                    \
+		*root_parent = _rl_node->right;                                     \
+		__typeof__(NODE) tmp = (*root_parent)->left;                        \
+		(*root_parent)->parent = _rl_node->parent;                          \
+		_rl_node->parent = (*root_parent);                                  \
+		if (tmp)                                                            \
+			tmp->parent = _rl_node;                                         \
+		(*root_parent)->left = _rl_node;                                    \
+		_rl_node->right = tmp;                                              \
+		AUGMENT(_rl_node);                                                  \
+		AUGMENT(_rl_node->parent);                                          \
+		ret = 0;                                                            \
+out_rl:                                                                     \
+		ret;                                                                \
 	})
 
-#define RB_GENERIC_INSERT(ROOT, BASE, NODE)                                \
-	({                                                                     \
-		__label__ out_rbi;                                                 \
-		int ret = BST_GENERIC_INSERT(ROOT, BASE, NODE);                    \
-		if (ret == -1)                                                     \
-			goto out_rbi;                                                  \
-		if ((ROOT) == (NODE))                                              \
-			(ROOT)->colour = BLACK;                                        \
-		else                                                               \
-			(NODE)->colour = RED;                                          \
-		for (__typeof__(NODE) node = NODE;                                 \
-			 node && node->parent && node->parent->colour != BLACK;) {     \
-			int direction = (node->parent->right == node) ? RIGHT : LEFT;  \
-			__typeof__(NODE) grandparent = node->parent->parent;           \
-			if (grandparent == NULL) {                                     \
-				break;                                                     \
-			}                                                              \
-			__typeof__(NODE) uncle = (node->parent == grandparent->left) ? \
-										 grandparent->right :              \
-										 grandparent->left;                \
-			if (uncle == NULL || uncle->colour == BLACK) {                 \
-				if (direction == LEFT) {                                   \
-					RB_ROTATE_LEFT(ROOT, node->parent);                    \
-				} else if (direction == RIGHT) {                           \
-					RB_ROTATE_RIGHT(ROOT, grandparent);                    \
-				} else {                                                   \
-					ret = -1;                                              \
-					goto out_rbi;                                          \
-				}                                                          \
-				node->parent->colour = BLACK;                              \
-				grandparent->colour = BLACK;                               \
-			} else if (uncle && uncle->colour == RED) {                    \
-				node->parent->colour = BLACK;                              \
-				grandparent->colour = RED;                                 \
-				uncle->colour = BLACK;                                     \
-				continue;                                                  \
-			} else {                                                       \
-				ret = -1;                                                  \
-				goto out_rbi;                                              \
-			}                                                              \
-		}                                                                  \
-out_rbi:                                                                   \
-		ret;                                                               \
-	})
+#define RB_ROTATE_LEFT(ROOT, NODE)                        \
+	RB_ROTATE_LEFT_AUGMENTED(ROOT, NODE, RB_AUGMENT_NONE)
 
-#define RB_GENERIC_DELETE(TABLE_ROOT, NODE)                                 \
+#define RB_AUGMENTED_INSERT(ROOT, BASE, NODE, AUGMENT)                      \
 	({                                                                      \
-		__label__ out_rbd;                                                  \
-		__typeof__(NODE) sibling = (NODE)->parent ?                         \
-									   (((NODE)->parent->left == (NODE)) ?  \
-											(NODE)->parent->right :         \
-											(NODE)->parent->left) :         \
-									   NULL;                                \
-		int ret = BST_GENERIC_DELETE(TABLE_ROOT, NODE);                     \
+		__label__ out_rbi;                                                  \
+		int ret = BST_GENERIC_INSERT(ROOT, BASE, NODE);                     \
 		if (ret == -1)                                                      \
-			goto out_rbd;                                                   \
-		if (sibling == NULL)                                                \
-			goto out_rbd;                                                   \
-		for (; sibling;) {                                                  \
-			if (sibling->colour == RED) {                                   \
-				sibling->colour = BLACK;                                    \
-				(NODE)->parent->colour = RED;                               \
-				if ((NODE)->parent->left == (NODE))                         \
-					RB_ROTATE_LEFT(TABLE_ROOT, (NODE)->parent);             \
-				else                                                        \
-					RB_ROTATE_RIGHT(TABLE_ROOT, (NODE)->parent);            \
-				sibling = (NODE)->parent->left == (NODE) ?                  \
-							  (NODE)->parent->right :                       \
-							  (NODE)->parent->left;                         \
+			goto out_rbi;                                                   \
+		RB_AUGMENT_PROPAGATE(NODE, AUGMENT);                                \
+		__typeof__(NODE) _rbi_node = (NODE);                                \
+		_rbi_node->colour = RED;                                            \
+		while (_rbi_node->parent && _rbi_node->parent->colour == RED) {     \
+			__typeof__(NODE) _rbi_parent = _rbi_node->parent;               \
+			__typeof__(NODE) _rbi_grandparent = _rbi_parent->parent;        \
+			int _rbi_direction =                                            \
+				(_rbi_parent == _rbi_grandparent->left) ? LEFT : RIGHT;     \
+			__typeof__(NODE) _rbi_uncle = (_rbi_direction == LEFT) ?        \
+											 _rbi_grandparent->right :      \
+											 _rbi_grandparent->left;        \
+			if (_rbi_uncle && _rbi_uncle->colour == RED) {                  \
+				_rbi_parent->colour = BLACK;                                \
+				_rbi_uncle->colour = BLACK;                                 \
+				_rbi_grandparent->colour = RED;                             \
+				_rbi_node = _rbi_grandparent;                               \
+				continue;                                                   \
+			}                                                               \
+			if (_rbi_direction == LEFT) {                                   \
+				if (_rbi_node == _rbi_parent->right) {                      \
+					RB_ROTATE_LEFT_AUGMENTED(ROOT, _rbi_parent, AUGMENT);   \
+					_rbi_parent = _rbi_node;                                \
+				}                                                           \
+				RB_ROTATE_RIGHT_AUGMENTED(ROOT, _rbi_grandparent, AUGMENT); \
 			} else {                                                        \
-				if ((sibling->left && sibling->left->colour == RED) ||      \
-					(sibling->right && sibling->right->colour == RED)) {    \
-					if (sibling->left && sibling->left->colour == RED) {    \
-						if (sibling->parent->left == sibling) {             \
-							sibling->left->colour = BLACK;                  \
-							sibling->colour = RED;                          \
-							RB_ROTATE_RIGHT(TABLE_ROOT, sibling);           \
-						}                                                   \
-					}                                                       \
-					sibling->colour = sibling->parent->colour;              \
-					sibling->parent->colour = BLACK;                        \
-					if (sibling->right)                                     \
-						sibling->right->colour = BLACK;                     \
-					if ((NODE)->parent->left == (NODE))                     \
-						RB_ROTATE_LEFT(TABLE_ROOT, (NODE)->parent);         \
-					else                                                    \
-						RB_ROTATE_RIGHT(TABLE_ROOT, (NODE)->parent);        \
-					break;                                                  \
-				} else {                                                    \
-					if (sibling->parent->colour == BLACK) {                 \
-						sibling->colour = RED;                              \
-						__typeof__(NODE) grandparent =                      \
-							(NODE)->parent ? (NODE)->parent->parent : NULL; \
-						sibling = grandparent ?                             \
-									  ((grandparent->left == (NODE)) ?      \
-										   grandparent->right :             \
-										   grandparent->left) :             \
-									  NULL;                                 \
-					} else {                                                \
-						sibling->colour = RED;                              \
-						sibling->parent->colour = BLACK;                    \
-						break;                                              \
-					}                                                       \
+				if (_rbi_node == _rbi_parent->left) {                       \
+					RB_ROTATE_RIGHT_AUGMENTED(ROOT, _rbi_parent, AUGMENT);  \
+					_rbi_parent = _rbi_node;                                \
 				}                                                           \
+				RB_ROTATE_LEFT_AUGMENTED(ROOT, _rbi_grandparent, AUGMENT);  \
 			}                                                               \
+			_rbi_parent->colour = BLACK;                                    \
+			_rbi_grandparent->colour = RED;                                 \
+			break;                                                          \
 		}                                                                   \
-out_rbd:                                                                    \
-		(NODE)->parent = NULL;                                              \
-		(NODE)->left = NULL;                                                \
-		(NODE)->right = NULL;                                               \
+		(ROOT)->colour = BLACK;                                             \
+out_rbi:                                                                    \
 		ret;                                                                \
 	})
 
+#define RB_GENERIC_INSERT(ROOT, BASE, NODE)                \
+	RB_AUGMENTED_INSERT(ROOT, BASE, NODE, RB_AUGMENT_NONE)
+
+// Rebalance after removing a black node. CHILD took its place and may be
+// NULL, so its parent is tracked separately.
+#define RB_DELETE_FIXUP(ROOT, CHILD, PARENT, AUGMENT)                       \
+	({                                                                      \
+		__typeof__(CHILD) _rdf_child = (CHILD);                             \
+		__typeof__(CHILD) _rdf_parent = (PARENT);                           \
+		while (_rdf_child != (ROOT) &&                                      \
+			   (_rdf_child == NULL || _rdf_child->colour == BLACK)) {       \
+			if (_rdf_child == _rdf_parent->left) {                          \
+				__typeof__(CHILD) _rdf_sibling = _rdf_parent->right;        \
+				if (_rdf_sibling->colour == RED) {                          \
+					_rdf_sibling->colour = BLACK;                           \
+					_rdf_parent->colour = RED;                              \
+					RB_ROTATE_LEFT_AUGMENTED(ROOT, _rdf_parent, AUGMENT);   \
+					_rdf_sibling = _rdf_parent->right;                      \
+				}                                                           \
+				if ((_rdf_sibling->left == NULL ||                          \
+					 _rdf_sibling->left->colour == BLACK) &&                \
+					(_rdf_sibling->right == NULL ||                         \
+					 _rdf_sibling->right->colour == BLACK)) {               \
+					_rdf_sibling->colour = RED;                             \
+					_rdf_child = _rdf_parent;                               \
+					_rdf_parent = _rdf_child->parent;                       \
+					continue;                                               \
+				}                                                           \
+				if (_rdf_sibling->right == NULL ||                          \
+					_rdf_sibling->right->colour == BLACK) {                 \
+					_rdf_sibling->left->colour = BLACK;                     \
+					_rdf_sibling->colour = RED;                             \
+					RB_ROTATE_RIGHT_AUGMENTED(ROOT, _rdf_sibling, AUGMENT); \
+					_rdf_sibling = _rdf_parent->right;                      \
+				}                                                           \
+				_rdf_sibling->colour = _rdf_parent->colour;                 \
+				_rdf_parent->colour = BLACK;                                \
+				_rdf_sibling->right->colour = BLACK;                        \
+				RB_ROTATE_LEFT_AUGMENTED(ROOT, _rdf_parent, AUGMENT);       \
+			} else {                                                        \
+				__typeof__(CHILD) _rdf_sibling = _rdf_parent->left;         \
+				if (_rdf_sibling->colour == RED) {                          \
+					_rdf_sibling->colour = BLACK;                           \
+					_rdf_parent->colour = RED;                              \
+					RB_ROTATE_RIGHT_AUGMENTED(ROOT, _rdf_parent, AUGMENT);  \
+					_rdf_sibling = _rdf_parent->left;                       \
+				}                                                           \
+				if ((_rdf_sibling->left == NULL ||                          \
+					 _rdf_sibling->left->colour == BLACK) &&                \
+					(_rdf_sibling->right == NULL ||                         \
+					 _rdf_sibling->right->colour == BLACK)) {               \
+					_rdf_sibling->colour = RED;                             \
+					_rdf_child = _rdf_parent;                               \
+					_rdf_parent = _rdf_child->parent;                       \
+					continue;                                               \
+				}                                                           \
+				if (_rdf_sibling->left == NULL ||                           \
+					_rdf_sibling->left->colour == BLACK) {                  \
+					_rdf_sibling->right->colour = BLACK;                    \
+					_rdf_sibling->colour = RED;                             \
+					RB_ROTATE_LEFT_AUGMENTED(ROOT, _rdf_sibling, AUGMENT);  \
+					_rdf_sibling = _rdf_parent->left;                       \
+				}                                                           \
+				_rdf_sibling->colour = _rdf_parent->colour;                 \
+				_rdf_parent->colour = BLACK;                                \
+				_rdf_sibling->left->colour = BLACK;                         \
+				RB_ROTATE_RIGHT_AUGMENTED(ROOT, _rdf_parent, AUGMENT);      \
+			}                                                               \
+			_rdf_child = (ROOT);                                            \
+		}                                                                   \
+		if (_rdf_child)                                                     \
+			_rdf_child->colour = BLACK;                                     \
+	})
+
+#define RB_AUGMENTED_DELETE(TABLE_ROOT, NODE, AUGMENT)                         \
+	({                                                                         \
+		__label__ out_rbd;                                                     \
+		int ret = -1;                                                          \
+		__typeof__(NODE) _rbd_node = (NODE);                                   \
+		if (_rbd_node == NULL)                                                 \
+			goto out_rbd;                                                      \
+		__typeof__(NODE) _rbd_child;                                           \
+		__typeof__(NODE) _rbd_parent;                                          \
+		int _rbd_colour = _rbd_node->colour;                                   \
+		if (_rbd_node->left == NULL || _rbd_node->right == NULL) {             \
+			_rbd_child = _rbd_node->left ? _rbd_node->left : _rbd_node->right; \
+			_rbd_parent = _rbd_node->parent;                                   \
+			RB_TRANSPLANT(TABLE_ROOT, _rbd_node, _rbd_child);                  \
+		} else {                                                               \
+			__typeof__(NODE) _rbd_successor = _rbd_node->right;                \
+			while (_rbd_successor->left)                                       \
+				_rbd_successor = _rbd_successor->left;                         \
+			_rbd_colour = _rbd_successor->colour;                              \
+			_rbd_child = _rbd_successor->right;                                \
+			if (_rbd_successor->parent == _rbd_node) {                         \
+				_rbd_parent = _rbd_successor;                                  \
+			} else {                                                           \
+				_rbd_parent = _rbd_successor->parent;                          \
+				RB_TRANSPLANT(TABLE_ROOT, _rbd_successor, _rbd_child);         \
+				_rbd_successor->right = _rbd_node->right;                      \
+				_rbd_successor->right->parent = _rbd_successor;                \
+			}                                                                  \
+			RB_TRANSPLANT(TABLE_ROOT, _rbd_node, _rbd_successor);              \
+			_rbd_successor->left = _rbd_node->left;                            \
+			_rbd_successor->left->parent = _rbd_successor;                     \
+			_rbd_successor->colour = _rbd_node->colour;                        \
+		}                                                                      \
+		RB_AUGMENT_PROPAGATE(_rbd_parent, AUGMENT);                            \
+		if (_rbd_colour == BLACK)                                              \
+			RB_DELETE_FIXUP(TABLE_ROOT, _rbd_child, _rbd_parent, AUGMENT);     \
+		_rbd_node->parent = NULL;                                              \
+		_rbd_node->left = NULL;                                                \
+		_rbd_node->right = NULL;                                               \
+		ret = 0;                                                               \
+out_rbd:                                                                       \
+		ret;                                                                   \
+	})
+
+#define RB_GENERIC_DELETE(TABLE_ROOT, NODE)                \
+	RB_AUGMENTED_DELETE(TABLE_ROOT, NODE, RB_AUGMENT_NONE)
+
+/*
+ * Root that also caches the leftmost node, so the minimum (e.g. the next
+ * timer to expire) is available in O(1). Searches and iteration use the
+ * BST_* macros on ROOT.node.
+ */
+#define RB_ROOT(TYPE)   \
+	struct {            \
+		TYPE *node;     \
+		TYPE *leftmost; \
+	}
+
+#define RB_FIRST_CACHED(ROOT) ((ROOT).leftmost)
+
+#define RB_CACHED_INSERT(ROOT, BASE, NODE)                              \
+	({                                                                  \
+		__typeof__((ROOT).node) _rci_node = (NODE);                     \
+		int _rci_ret = RB_GENERIC_INSERT((ROOT).node, BASE, _rci_node); \
+		if (_rci_ret == 0 && ((ROOT).leftmost == NULL ||                \
+							  _rci_node->BASE < (ROOT).leftmost->BASE)) \
+			(ROOT).leftmost = _rci_node;                                \
+		_rci_ret;                                                       \
+	})
+
+#define RB_CACHED_DELETE(ROOT, NODE)                   \
+	({                                                 \
+		__typeof__((ROOT).node) _rcd_node = (NODE);    \
+		if (_rcd_node && _rcd_node == (ROOT).leftmost) \
+			(ROOT).leftmost = BST_NEXT(_rcd_node);     \
+		RB_GENERIC_DELETE((ROOT).node, _rcd_node);     \
+	})
+
 #endif
@@ -0,0 +1,16 @@
+#include <aria/sched.h>
+#include <aria/syscall.h>
+
+int futex_wait(uint32_t *address, uint32_t expected)
+{
+	struct syscall_response syscall_response =
+		SYSCALL3(SYSCALL_FUTEX, address, FUTEX_WAIT, expected);
+	return syscall_response.ret;
+}
+
+int futex_wake(uint32_t *address, int count)
+{
+	struct syscall_response syscall_response =
+		SYSCALL3(SYSCALL_FUTEX, address, FUTEX_WAKE, count);
+	return syscall_response.ret;
+}
@@ -15,4 +15,7 @@ constexpr int ARCHCTL_YIELD = 5;
 constexpr int FUTEX_WAIT = 1;
 constexpr int FUTEX_WAKE = 2;
 
+int futex_wait(uint32_t *address, uint32_t expected);
+int futex_wake(uint32_t *address, int count);
+
 #endif
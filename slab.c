@@ -323,6 +323,9 @@ void *realloc(void *obj, size_t size)
 	}
 
 	void *ret = alloc(size);
+	if (ret == NULL) {
+		return NULL;
+	}
 
 	memcpy(ret, obj, object_size);
 	free(obj);
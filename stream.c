@@ -63,6 +63,18 @@ int stream_print(struct stream_info *stream, const char *str, va_list arg)
 	return 0;
 }
 
+int stream_printf(struct stream_info *stream, const char *str, ...)
+{
+	va_list arg;
+	va_start(arg, str);
+
+	int ret = stream_print(stream, str, arg);
+
+	va_end(arg);
+
+	return ret;
+}
+
 static void stream_write_number(struct stream_info *stream, uint64_t number,
 								int base)
 {
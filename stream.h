@@ -11,5 +11,6 @@ struct stream_info {
 };
 
 int stream_print(struct stream_info *stream, const char *str, va_list arg);
+int stream_printf(struct stream_info *stream, const char *str, ...);
 
 #endif
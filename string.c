@@ -95,6 +95,20 @@ void memcpy(void *dest, const void *src, size_t n)
 	memcpy8(dest, src, n);
 }
 
+void memmove(void *dest, const void *src, size_t n)
+{
+	uint8_t *d = dest;
+	const uint8_t *s = src;
+
+	if (d <= s || d >= s + n) {
+		memcpy8(d, s, n);
+		return;
+	}
+
+	while (n--)
+		d[n] = s[n];
+}
+
 void memset(void *src, int data, size_t n)
 {
 	memset8(src, data, n);
@@ -101,6 +101,7 @@ char *strcpy(char *dest, const char *src);
 char *strncpy(char *dest, const char *src, size_t n);
 char *strchr(const char *str, char c);
 void memcpy(void *dest, const void *src, size_t n);
+void memmove(void *dest, const void *src, size_t n);
 void memset(void *src, int data, size_t n);
 void sprint(char *str, ...);
 
@@ -1,30 +1,65 @@
 #include <aria/time.h>
 
-struct time invariant_tsc_read(struct timer *timer)
+/*
+ * Pick the largest shift for which mult = (NANO_PER_SECOND << shift) / freq
+ * still fits in 63 bits, and compute it by long division since the
+ * numerator does not fit in 64 bits.
+ */
+int timer_calibrate(struct timer *timer, freq_t freq, uint64_t base)
+{
+	if (timer == NULL || freq <= 0)
+		return -1;
+
+	uint64_t quotient = NANO_PER_SECOND / freq;
+	uint64_t remainder = NANO_PER_SECOND % freq;
+	uint32_t shift = 63 - (64 - __builtin_clzll(quotient + 1));
+
+	for (uint32_t i = 0; i < shift; i++) {
+		quotient <<= 1;
+		remainder <<= 1;
+		if (remainder >= (uint64_t)freq) {
+			remainder -= freq;
+			quotient |= 1;
+		}
+	}
+
+	timer->freq = freq;
+	timer->mult = quotient;
+	timer->shift = shift;
+	timer->base = base;
+
+	return 0;
+}
+
+struct time time_convert(struct timer *timer, time_t counter)
 {
 	struct time ret = { .sec = 0, .nsec = 0 };
 	if (timer == NULL)
 		return ret;
 
-	uint64_t tsc = ({
-		uint64_t rax, rdx;
-		__asm__ volatile("rdtsc" : "=a"(rax), "=d"(rdx));
-		(uint64_t)rax | ((uint64_t)rdx << 32);
-	});
+	if (timer->mult == 0 &&
+		timer_calibrate(timer, timer->freq, timer->base) == -1)
+		return ret;
 
-	uint64_t ns = (tsc * NANO_PER_SECOND) / timer->freq;
+	uint64_t delta = (uint64_t)counter - timer->base;
+	uint64_t ns = ((unsigned __int128)delta * timer->mult) >> timer->shift;
 
-	ret = (struct time){ .nsec = ns % NANO_PER_SECOND,
-						 .sec = ns / NANO_PER_SECOND };
+	ret.sec = ns / NANO_PER_SECOND;
+	ret.nsec = ns - ret.sec * NANO_PER_SECOND;
 
 	return ret;
 }
 
+struct time invariant_tsc_read(struct timer *timer)
+{
+	return time_convert(timer, tsc_read());
+}
+
 struct time time_add(struct time a, struct time b)
 {
 	struct time ret = { .sec = a.sec + b.sec, .nsec = a.nsec + b.nsec };
 
-	if (ret.nsec > NANO_PER_SECOND) {
+	if (ret.nsec >= NANO_PER_SECOND) {
 		ret.nsec -= NANO_PER_SECOND;
 		ret.sec++;
 	}
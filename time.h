@@ -21,15 +21,32 @@ struct time {
 #define TIME_SOURCE_INVARIANT_TSC 1
 #define TIME_SOURCE_HPET 2
 
+/*
+ * Counter values are converted with ns = ((counter - base) * mult) >> shift,
+ * with a 128-bit product so the conversion needs no divide and does not
+ * overflow for centuries of uptime. mult and shift are derived from freq by
+ * timer_calibrate, base is the counter value that maps to zero.
+ */
 struct timer {
 	int source;
 	freq_t freq;
+	uint64_t mult;
+	uint32_t shift;
+	uint64_t base;
 	struct time (*read)(struct timer *);
 };
 
+static inline uint64_t tsc_read(void)
+{
+	uint64_t rax, rdx;
+	__asm__ volatile("rdtsc" : "=a"(rax), "=d"(rdx));
+	return rax | (rdx << 32);
+}
+
 struct time time_add(struct time, struct time);
 struct time time_sub(struct time, struct time);
 struct time time_convert(struct timer *, time_t);
+int timer_calibrate(struct timer *, freq_t, uint64_t base);
 time_t time_to_ns(struct time);
 
 struct time invariant_tsc_read(struct timer *timer);
@@ -0,0 +1,304 @@
+#include <aria/timer_wheel.h>
+#include <aria/string.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(L) ((L) * TIMER_WHEEL_SLOT_BITS)
+
+static uint64_t time_to_tick(struct timer_wheel *wheel, struct time t,
+							 bool round_up)
+{
+	time_t ns = time_to_ns(t);
+	if (ns < 0) {
+		return 0;
+	}
+
+	if (round_up) {
+		ns += wheel->resolution - 1;
+	}
+
+	return ns / wheel->resolution;
+}
+
+static struct time tick_to_time(struct timer_wheel *wheel, uint64_t tick)
+{
+	time_t ns = tick * wheel->resolution;
+
+	return (struct time){ .sec = ns / NANO_PER_SECOND,
+						  .nsec = ns % NANO_PER_SECOND };
+}
+
+static void detach(struct timer_wheel_entry *entry)
+{
+	*entry->pprev = entry->next;
+	if (entry->next) {
+		entry->next->pprev = entry->pprev;
+	}
+
+	entry->next = NULL;
+	entry->pprev = NULL;
+}
+
+/*
+ * The level of an entry is the highest group of slot bits in which its
+ * expiry differs from the current tick, so it is in a slot of that level
+ * ahead of the current one and gets cascaded when the tick reaches that
+ * slot. Entries beyond the top level are parked in the next top level slot
+ * and placed again from there.
+ */
+static void place(struct timer_wheel *wheel, struct timer_wheel_entry *entry)
+{
+	uint64_t expires = entry->expires;
+	int level = 0;
+	size_t slot;
+
+	if (expires != wheel->now) {
+		level = (63 - __builtin_clzll(expires ^ wheel->now)) /
+				TIMER_WHEEL_SLOT_BITS;
+	}
+
+	if (level < TIMER_WHEEL_LEVELS) {
+		slot = (expires >> LEVEL_SHIFT(level)) & SLOT_MASK;
+	} else {
+		level = TIMER_WHEEL_LEVELS - 1;
+		slot = ((wheel->now >> LEVEL_SHIFT(level)) + 1) & SLOT_MASK;
+	}
+
+	struct timer_wheel_entry **head = &wheel->slots[level][slot];
+
+	entry->next = *head;
+	entry->pprev = head;
+	if (*head) {
+		(*head)->pprev = &entry->next;
+	}
+	*head = entry;
+
+	wheel->occupied[level] |= 1ull << slot;
+}
+
+static struct timer_wheel_entry *take_slot(struct timer_wheel *wheel,
+										   int level, size_t slot)
+{
+	struct timer_wheel_entry *list = wheel->slots[level][slot];
+
+	wheel->slots[level][slot] = NULL;
+	wheel->occupied[level] &= ~(1ull << slot);
+
+	return list;
+}
+
+static void cascade(struct timer_wheel *wheel, int level)
+{
+	size_t slot = (wheel->now >> LEVEL_SHIFT(level)) & SLOT_MASK;
+	struct timer_wheel_entry *entry = take_slot(wheel, level, slot);
+
+	while (entry) {
+		struct timer_wheel_entry *next = entry->next;
+		place(wheel, entry);
+		entry = next;
+	}
+}
+
+/*
+ * First tick at which something happens: the start of the nearest occupied
+ * slot of any level. Slots at or behind the current one in their rotation
+ * can only hold parked top level entries and are reached in the next
+ * rotation. Empty slots neither cascade nor expire anything, so the wheel
+ * can jump straight to this tick.
+ */
+static uint64_t next_event(struct timer_wheel *wheel)
+{
+	uint64_t tick = UINT64_MAX;
+
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint64_t occupied = wheel->occupied[level];
+		if (occupied == 0) {
+			continue;
+		}
+
+		int shift = LEVEL_SHIFT(level);
+		int rotation_shift = shift + TIMER_WHEEL_SLOT_BITS;
+		uint64_t rotation = (wheel->now >> rotation_shift) << rotation_shift;
+		size_t current = (wheel->now >> shift) & SLOT_MASK;
+
+		uint64_t ahead = 0;
+		if (current + 1 < TIMER_WHEEL_SLOTS) {
+			ahead = occupied & (~0ull << (current + 1));
+		}
+
+		uint64_t candidate;
+		if (ahead) {
+			candidate = rotation + ((uint64_t)__builtin_ctzll(ahead) << shift);
+		} else {
+			candidate = rotation + (1ull << rotation_shift) +
+						((uint64_t)__builtin_ctzll(occupied) << shift);
+		}
+
+		if (candidate < tick) {
+			tick = candidate;
+		}
+	}
+
+	return tick;
+}
+
+int timer_wheel_init(struct timer_wheel *wheel, struct timer *timer,
+					 time_t resolution)
+{
+	if (wheel == NULL || timer == NULL || resolution <= 0) {
+		return -1;
+	}
+
+	memset(wheel, 0, sizeof(*wheel));
+
+	wheel->timer = timer;
+	wheel->resolution = resolution;
+	wheel->now = time_to_tick(wheel, timer->read(timer), false);
+
+	return 0;
+}
+
+void timer_wheel_entry_init(struct timer_wheel_entry *entry,
+							timer_wheel_func *callback)
+{
+	entry->next = NULL;
+	entry->pprev = NULL;
+	entry->expires = 0;
+	entry->callback = callback;
+}
+
+void timer_wheel_arm(struct timer_wheel *wheel,
+					 struct timer_wheel_entry *entry, struct time expiry)
+{
+	if (timer_wheel_armed(entry)) {
+		detach(entry);
+		wheel->count--;
+	}
+
+	/* The slot of the current tick has already been expired */
+	entry->expires = time_to_tick(wheel, expiry, true);
+	if (entry->expires <= wheel->now) {
+		entry->expires = wheel->now + 1;
+	}
+
+	place(wheel, entry);
+	wheel->count++;
+}
+
+void timer_wheel_arm_in(struct timer_wheel *wheel,
+						struct timer_wheel_entry *entry, struct time delay)
+{
+	struct time now = wheel->timer->read(wheel->timer);
+
+	timer_wheel_arm(wheel, entry, time_add(now, delay));
+}
+
+int timer_wheel_cancel(struct timer_wheel *wheel,
+					   struct timer_wheel_entry *entry)
+{
+	if (!timer_wheel_armed(entry)) {
+		return -1;
+	}
+
+	struct timer_wheel_entry **head = entry->pprev;
+
+	detach(entry);
+	wheel->count--;
+
+	/*
+	 * Only the first entry of a slot points back into the slot array, so
+	 * that is the only case in which the slot may have become empty.
+	 */
+	uintptr_t offset = (uintptr_t)head - (uintptr_t)wheel->slots;
+	if (offset < sizeof(wheel->slots) && *head == NULL) {
+		size_t index = offset / sizeof(*head);
+		wheel->occupied[index / TIMER_WHEEL_SLOTS] &=
+			~(1ull << (index % TIMER_WHEEL_SLOTS));
+	}
+
+	return 0;
+}
+
+size_t timer_wheel_advance(struct timer_wheel *wheel)
+{
+	uint64_t target =
+		time_to_tick(wheel, wheel->timer->read(wheel->timer), false);
+	struct timer_wheel_entry **tail = &wheel->expired;
+	size_t fired = 0;
+
+	while (*tail) {
+		tail = &(*tail)->next;
+	}
+
+	while (wheel->now < target) {
+		uint64_t next = next_event(wheel);
+		if (next > target) {
+			wheel->now = target;
+			break;
+		}
+
+		wheel->now = next;
+
+		/* Cascade from the top so entries can drop through several levels */
+		int top = 1;
+		while (top < TIMER_WHEEL_LEVELS &&
+			   (wheel->now & ((1ull << LEVEL_SHIFT(top)) - 1)) == 0) {
+			top++;
+		}
+		for (int level = top - 1; level > 0; level--) {
+			cascade(wheel, level);
+		}
+
+		struct timer_wheel_entry *entry =
+			take_slot(wheel, 0, wheel->now & SLOT_MASK);
+		for (; entry; entry = entry->next) {
+			*tail = entry;
+			entry->pprev = tail;
+			tail = &entry->next;
+		}
+	}
+
+	/*
+	 * Callbacks only run once the wheel is consistent again. Always taking
+	 * the head lets them cancel entries that are still waiting in the batch.
+	 */
+	while (wheel->expired) {
+		struct timer_wheel_entry *entry = wheel->expired;
+
+		detach(entry);
+		wheel->count--;
+		fired++;
+
+		entry->callback(entry);
+	}
+
+	return fired;
+}
+
+int timer_wheel_next_expiry(struct timer_wheel *wheel, struct time *ret)
+{
+	if (wheel->count == 0) {
+		return -1;
+	}
+
+	if (wheel->expired) {
+		*ret = tick_to_time(wheel, wheel->now);
+		return 0;
+	}
+
+	*ret = tick_to_time(wheel, next_event(wheel));
+
+	return 0;
+}
+
+void timer_wheel_notify(struct notification_info *info, void *data,
+						int weight)
+{
+	(void)data;
+
+	if (info == NULL || info->private == NULL ||
+		!(weight & NOTIFY_WEIGHT_TICK)) {
+		return;
+	}
+
+	timer_wheel_advance(info->private);
+}
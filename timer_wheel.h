@@ -0,0 +1,97 @@
+#ifndef ARIA_TIMER_WHEEL_H_
+#define ARIA_TIMER_WHEEL_H_
+
+#include <aria/time.h>
+#include <aria/notification.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Hierarchical timing wheel. Time is counted in ticks of resolution
+ * nanoseconds, and level l has 64 slots of 64^l ticks each, so arming and
+ * cancelling are O(1) list operations. When the tick counter crosses a slot
+ * boundary of level l, that slot is cascaded: its entries are placed again
+ * relative to the new time and so move down towards level 0, whose slots
+ * expire. Timers further out than the top level covers are parked there and
+ * cascaded until they come in range.
+ *
+ * A timer never fires before its expiry, but may fire up to one tick late.
+ */
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS 8
+
+struct timer_wheel_entry;
+
+/* The object the entry is part of can be retrieved using CONTAINER_OF */
+typedef void timer_wheel_func(struct timer_wheel_entry *entry);
+
+struct timer_wheel_entry {
+	struct timer_wheel_entry *next;
+	/* Link pointing at this entry, NULL while the entry is not armed */
+	struct timer_wheel_entry **pprev;
+	uint64_t expires;
+	timer_wheel_func *callback;
+};
+
+struct timer_wheel {
+	struct timer *timer;
+	time_t resolution;
+	uint64_t now;
+	size_t count;
+	/* Bit s is set when slots[l][s] is not empty */
+	uint64_t occupied[TIMER_WHEEL_LEVELS];
+	struct timer_wheel_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	/* Entries that have expired but whose callback has not run yet */
+	struct timer_wheel_entry *expired;
+};
+
+/* resolution is the length of a tick in nanoseconds */
+int timer_wheel_init(struct timer_wheel *wheel, struct timer *timer,
+					 time_t resolution);
+
+void timer_wheel_entry_init(struct timer_wheel_entry *entry,
+							timer_wheel_func *callback);
+
+/* Arming an entry that is already armed moves it to the new expiry */
+void timer_wheel_arm(struct timer_wheel *wheel,
+					 struct timer_wheel_entry *entry, struct time expiry);
+void timer_wheel_arm_in(struct timer_wheel *wheel,
+						struct timer_wheel_entry *entry, struct time delay);
+
+/* Returns -1 if the entry was not armed */
+int timer_wheel_cancel(struct timer_wheel *wheel,
+					   struct timer_wheel_entry *entry);
+
+static inline bool timer_wheel_armed(const struct timer_wheel_entry *entry)
+{
+	return entry->pprev != NULL;
+}
+
+/*
+ * Bring the wheel up to timer->read and run the callbacks of every entry
+ * that expired on the way, in expiry order, as one batch once the wheel
+ * itself is up to date. Callbacks may arm and cancel entries, but must not
+ * advance the wheel. Returns the number of callbacks run.
+ */
+size_t timer_wheel_advance(struct timer_wheel *wheel);
+
+/*
+ * Time by which the wheel has to be advanced next. This is exact for timers
+ * in level 0 and otherwise the next cascade that may move one there, so
+ * sleeping until it and advancing never misses an expiry. Returns -1 if no
+ * timer is armed.
+ */
+int timer_wheel_next_expiry(struct timer_wheel *wheel, struct time *ret);
+
+/*
+ * Notification handler advancing the wheel in info->private on
+ * NOTIFY_WEIGHT_TICK, so that any number of timers due by a tick are run
+ * from a single wakeup.
+ */
+void timer_wheel_notify(struct notification_info *info, void *data,
+						int weight);
+
+#endif
@@ -0,0 +1,133 @@
+#include <aria/trace.h>
+#include <aria/slab.h>
+#include <aria/string.h>
+
+int trace_ring_init(struct trace_ring *ring, size_t capacity, uint32_t thread)
+{
+	if (ring == NULL || capacity == 0)
+		return -1;
+
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	ring->events = alloc(size * sizeof(struct trace_event));
+	if (ring->events == NULL)
+		return -1;
+
+	ring->head = 0;
+	ring->mask = size - 1;
+	ring->thread = thread;
+
+	return 0;
+}
+
+void trace_ring_destroy(struct trace_ring *ring)
+{
+	free(ring->events);
+	ring->events = NULL;
+}
+
+size_t trace_ring_snapshot(struct trace_ring *ring, struct trace_event *events,
+						   size_t n)
+{
+	uint64_t capacity = ring->mask + 1;
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if (n > capacity)
+		n = capacity;
+	if (n > head)
+		n = head;
+
+	uint64_t start = head - n;
+	for (uint64_t i = start; i < head; i++)
+		events[i - start] = ring->events[i & ring->mask];
+
+	/*
+	 * Anything the owner may have lapped while we copied is garbage, and so
+	 * is the slot of event now, which it may be writing at this moment.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	uint64_t now = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	if (now - start < capacity)
+		return n;
+
+	uint64_t lost = now - start - capacity + 1;
+	if (lost >= n)
+		return 0;
+
+	memmove(events, events + lost, (n - lost) * sizeof(*events));
+
+	return n - lost;
+}
+
+static void trace_write_event(struct stream_info *stream,
+							  struct trace_ring *ring,
+							  struct trace_event *event, struct timer *timer,
+							  trace_name_func *name)
+{
+	time_t ns = time_to_ns(time_convert(timer, event->timestamp));
+	uint64_t micro = ns / 1000, fraction = ns % 1000;
+
+	stream_printf(stream, "{\"name\":\"");
+	if (name)
+		stream_printf(stream, "%s", name(event->id));
+	else
+		stream_printf(stream, "%d", (uint64_t)event->id);
+
+	/* Chrome wants microseconds, keep the nanoseconds as decimals */
+	stream_printf(stream, "\",\"ph\":\"%c\",\"ts\":%d.%d%d%d",
+				  event->phase, micro, fraction / 100, fraction / 10 % 10,
+				  fraction % 10);
+	stream_printf(stream, ",\"pid\":0,\"tid\":%d", (uint64_t)ring->thread);
+
+	if (event->phase == TRACE_PHASE_INSTANT)
+		stream_printf(stream, ",\"s\":\"t\"");
+
+	stream_printf(stream, ",\"args\":{\"arg0\":%d,\"arg1\":%d}}",
+				  event->args[0], event->args[1]);
+}
+
+int trace_export(struct stream_info *stream, struct trace_ring **rings,
+				 size_t n, struct timer *timer, trace_name_func *name)
+{
+	if (stream == NULL || stream->write == NULL || timer == NULL)
+		return -1;
+
+	/* Allocate before writing anything, so a failure leaves no partial JSON */
+	size_t capacity = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (rings[i]->mask + 1 > capacity)
+			capacity = rings[i]->mask + 1;
+	}
+
+	struct trace_event *events = NULL;
+	if (capacity) {
+		events = alloc(capacity * sizeof(struct trace_event));
+		if (events == NULL)
+			return -1;
+	}
+
+	bool first = true;
+
+	stream_printf(stream, "{\"traceEvents\":[");
+
+	for (size_t i = 0; i < n; i++) {
+		struct trace_ring *ring = rings[i];
+
+		size_t count = trace_ring_snapshot(ring, events, ring->mask + 1);
+		for (size_t j = 0; j < count; j++) {
+			if (!first)
+				stream_printf(stream, ",\n");
+			first = false;
+
+			trace_write_event(stream, ring, &events[j], timer, name);
+		}
+	}
+
+	stream_printf(stream, "]}\n");
+
+	free(events);
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef ARIA_TRACE_H_
+#define ARIA_TRACE_H_
+
+#include <aria/time.h>
+#include <aria/stream.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Event tracing into per-thread rings. Each thread records into its own
+ * ring, so recording is a TSC read, a 32-byte store and a release store of
+ * the head followed by a release fence, with no locks or read-modify-write
+ * atomics. The ring is a
+ * flight recorder: once it is full the oldest events are overwritten.
+ *
+ * Captured rings are exported as Chrome trace JSON, which can be loaded
+ * into chrome://tracing or Perfetto.
+ */
+constexpr uint8_t TRACE_PHASE_BEGIN = 'B';
+constexpr uint8_t TRACE_PHASE_END = 'E';
+constexpr uint8_t TRACE_PHASE_INSTANT = 'i';
+
+struct trace_event {
+	uint64_t timestamp;
+	uint32_t id;
+	uint8_t phase;
+	uint8_t reserved[3];
+	uint64_t args[2];
+};
+
+static_assert(sizeof(struct trace_event) == 32, "trace event is 32 bytes");
+
+struct trace_ring {
+	/* Number of events ever recorded, only written by the owning thread */
+	uint64_t head;
+	uint64_t mask;
+	uint32_t thread;
+	struct trace_event *events;
+};
+
+/* Names the event ids in the export, ids are printed as numbers without it */
+typedef const char *trace_name_func(uint32_t id);
+
+/* capacity is rounded up to a power of two */
+int trace_ring_init(struct trace_ring *ring, size_t capacity, uint32_t thread);
+void trace_ring_destroy(struct trace_ring *ring);
+
+static inline void trace_record(struct trace_ring *ring, uint8_t phase,
+								uint32_t id, uint64_t arg0, uint64_t arg1)
+{
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	struct trace_event *event = &ring->events[head & ring->mask];
+
+	event->timestamp = tsc_read();
+	event->id = id;
+	event->phase = phase;
+	event->args[0] = arg0;
+	event->args[1] = arg1;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	/*
+	 * The release store only keeps this event ahead of the head. The fence
+	 * also keeps the stores of the next event behind it, as a reader takes
+	 * a slot past the head to be untouched.
+	 */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// Up to two optional arguments, missing ones are recorded as 0.
+#define _TRACE_ARG0(A, ...) (A)
+#define _TRACE_ARG1(A, B, ...) (B)
+
+#define TRACE_RECORD(RING, PHASE, ID, ...)                      \
+	trace_record(RING, PHASE, ID,                               \
+				 _TRACE_ARG0(__VA_ARGS__ __VA_OPT__(, ) 0, 0), \
+				 _TRACE_ARG1(__VA_ARGS__ __VA_OPT__(, ) 0, 0))
+
+#define TRACE_BEGIN(RING, ID, ...) \
+	TRACE_RECORD(RING, TRACE_PHASE_BEGIN, ID, __VA_ARGS__)
+#define TRACE_END(RING, ID, ...) \
+	TRACE_RECORD(RING, TRACE_PHASE_END, ID, __VA_ARGS__)
+#define TRACE_INSTANT(RING, ID, ...) \
+	TRACE_RECORD(RING, TRACE_PHASE_INSTANT, ID, __VA_ARGS__)
+
+/*
+ * Copy up to n of the most recent events, oldest first. May run while the
+ * owner keeps recording; events overwritten during the copy are dropped.
+ * Returns the number of events copied.
+ */
+size_t trace_ring_snapshot(struct trace_ring *ring, struct trace_event *events,
+						   size_t n);
+
+/*
+ * Write the events of all rings as a Chrome trace JSON object, with
+ * timestamps converted through timer.
+ */
+int trace_export(struct stream_info *stream, struct trace_ring **rings,
+				 size_t n, struct timer *timer, trace_name_func *name);
+
+#endif
@@ -2,47 +2,114 @@
 #define ARIA_VECTOR_H_
 
 #include <aria/slab.h>
+#include <aria/string.h>
 
-#define VECTOR(TYPE)            \
+/*
+ * Growable array. Capacity doubles whenever it runs out, so a sequence of
+ * pushes costs amortized O(1) per element. Every macro that may allocate
+ * evaluates to 0 on success or -1 if the allocation failed, in which case
+ * the vector is left untouched.
+ *
+ * SMALL_VECTOR keeps up to N elements in inline_data and only moves to
+ * the heap once it outgrows them; VECTOR is the N = 0 case. data is NULL
+ * while the elements live inline, so a zeroed vector is a valid empty one
+ * and can be copied freely, but elements must be reached through
+ * VECTOR_DATA.
+ */
+#define SMALL_VECTOR(TYPE, N)   \
 	struct {                    \
 		TYPE *data;             \
 		size_t length;          \
 		size_t buffer_capacity; \
+		TYPE inline_data[N];    \
 	}
 
-#define VECTOR_INIT(THIS, SIZE)    \
-	(THIS).buffer_capacity = SIZE; \
-	(THIS).data =                  \
-		realloc((THIS).data, (THIS).buffer_capacity * sizeof(*(THIS).data));
-
-#define VECTOR_PUSH(THIS, ELEMENT)                                            \
-	({                                                                        \
-		__label__ _ret;                                                       \
-		if ((THIS).data == NULL) {                                            \
-			VECTOR_INIT(THIS, 1);                                             \
-		}                                                                     \
-		size_t _cap = (THIS).length + 1;                                      \
-		if (_cap <= (THIS).buffer_capacity) {                                 \
-			goto _ret;                                                        \
-		}                                                                     \
-		(THIS).buffer_capacity *= 2;                                          \
-		(THIS).data = realloc((THIS).data,                                    \
-							  (THIS).buffer_capacity * sizeof(*(THIS).data)); \
-_ret:                                                                         \
-		(THIS).data[(THIS).length++] = ELEMENT;                               \
+#define VECTOR(TYPE) SMALL_VECTOR(TYPE, 0)
+
+#define VECTOR_INLINE_CAPACITY(THIS)                           \
+	(sizeof((THIS).inline_data) / sizeof(*(THIS).inline_data))
+
+#define VECTOR_DATA(THIS) ((THIS).data ? (THIS).data : (THIS).inline_data)
+
+#define VECTOR_CAPACITY(THIS)                                             \
+	((THIS).data ? (THIS).buffer_capacity : VECTOR_INLINE_CAPACITY(THIS))
+
+#define VECTOR_MIN_CAPACITY 4
+
+#define VECTOR_RESERVE(THIS, CAPACITY)                                         \
+	({                                                                         \
+		int _vr_ret = 0;                                                       \
+		size_t _vr_capacity = (CAPACITY);                                      \
+		if (_vr_capacity > VECTOR_CAPACITY(THIS)) {                            \
+			__typeof__((THIS).data) _vr_data;                                  \
+			if ((THIS).data) {                                                 \
+				_vr_data =                                                     \
+					realloc((THIS).data, _vr_capacity * sizeof(*(THIS).data)); \
+			} else {                                                           \
+				_vr_data = alloc(_vr_capacity * sizeof(*(THIS).data));         \
+				if (_vr_data)                                                  \
+					memcpy(_vr_data, (THIS).inline_data,                       \
+						   (THIS).length * sizeof(*(THIS).data));              \
+			}                                                                  \
+			if (_vr_data == NULL) {                                            \
+				_vr_ret = -1;                                                  \
+			} else {                                                           \
+				(THIS).data = _vr_data;                                        \
+				(THIS).buffer_capacity = _vr_capacity;                         \
+			}                                                                  \
+		}                                                                      \
+		_vr_ret;                                                               \
 	})
 
-#define VECTOR_PEEK_END(THIS, ELEMENT)            \
-	({                                            \
-		__label__ finish;                         \
-		int _ret = 0;                             \
-		if ((THIS).length <= 0) {                 \
-			_ret = -1;                            \
-			goto finish;                          \
-		}                                         \
-		ELEMENT = (THIS).data[(THIS).length - 1]; \
-finish:                                           \
-		_ret;                                     \
+// Make room for at least NEEDED elements, at least doubling the capacity.
+#define VECTOR_GROW(THIS, NEEDED)                            \
+	({                                                       \
+		int _vg_ret = 0;                                     \
+		size_t _vg_needed = (NEEDED);                        \
+		if (_vg_needed > VECTOR_CAPACITY(THIS)) {            \
+			size_t _vg_capacity = VECTOR_CAPACITY(THIS) * 2; \
+			if (_vg_capacity < VECTOR_MIN_CAPACITY)          \
+				_vg_capacity = VECTOR_MIN_CAPACITY;          \
+			if (_vg_capacity < _vg_needed)                   \
+				_vg_capacity = _vg_needed;                   \
+			_vg_ret = VECTOR_RESERVE(THIS, _vg_capacity);    \
+		}                                                    \
+		_vg_ret;                                             \
+	})
+
+#define VECTOR_INIT(THIS, SIZE) VECTOR_RESERVE(THIS, SIZE)
+
+#define VECTOR_PUSH(THIS, ELEMENT)                          \
+	({                                                      \
+		int _vp_ret = VECTOR_GROW(THIS, (THIS).length + 1); \
+		if (_vp_ret == 0)                                   \
+			VECTOR_DATA(THIS)[(THIS).length++] = ELEMENT;   \
+		_vp_ret;                                            \
+	})
+
+#define VECTOR_APPEND_N(THIS, ELEMENTS, N)                        \
+	({                                                            \
+		size_t _va_n = (N);                                       \
+		int _va_ret = VECTOR_GROW(THIS, (THIS).length + _va_n);   \
+		if (_va_ret == 0) {                                       \
+			memcpy(VECTOR_DATA(THIS) + (THIS).length, (ELEMENTS), \
+				   _va_n * sizeof(*(THIS).data));                 \
+			(THIS).length += _va_n;                               \
+		}                                                         \
+		_va_ret;                                                  \
+	})
+
+#define VECTOR_PEEK_END(THIS, ELEMENT)                  \
+	({                                                  \
+		__label__ finish;                               \
+		int _ret = 0;                                   \
+		if ((THIS).length <= 0) {                       \
+			_ret = -1;                                  \
+			goto finish;                                \
+		}                                               \
+		ELEMENT = VECTOR_DATA(THIS)[(THIS).length - 1]; \
+finish:                                                 \
+		_ret;                                           \
 	})
 
 #define VECTOR_PEEK_BEGINNING(THIS, ELEMENT) \
@@ -53,42 +120,69 @@ finish:                                           \
 			_ret = -1;                       \
 			goto finish;                     \
 		}                                    \
-		ELEMENT = (THIS).data[0];            \
+		ELEMENT = VECTOR_DATA(THIS)[0];      \
 finish:                                      \
 		_ret;                                \
 	})
 
-#define VECTOR_INDEX(THIS, ELEMENT, INDEX)                                \
-	({                                                                    \
-		if ((INDEX) > (THIS).buffer_capacity) {                           \
-			(THIS).buffer_capacity += (INDEX) - (THIS).buffer_capacity;   \
-			(THIS).data = realloc((THIS.data), (THIS).buffer_capacity *   \
-												   sizeof(*(THIS).data)); \
-		}                                                                 \
-		if ((INDEX) > (THIS).length) {                                    \
-			(THIS).length += (INDEX) - (THIS).length;                     \
-		}                                                                 \
-		(THIS).data[INDEX] = ELEMENT;                                     \
+// Store ELEMENT at INDEX, extending the vector with zeroed elements if INDEX
+// is past the end.
+#define VECTOR_INDEX(THIS, ELEMENT, INDEX)                   \
+	({                                                       \
+		size_t _vi_index = (INDEX);                          \
+		int _vi_ret = VECTOR_GROW(THIS, _vi_index + 1);      \
+		if (_vi_ret == 0) {                                  \
+			if (_vi_index >= (THIS).length) {                \
+				memset(VECTOR_DATA(THIS) + (THIS).length, 0, \
+					   (_vi_index + 1 - (THIS).length) *     \
+						   sizeof(*(THIS).data));            \
+				(THIS).length = _vi_index + 1;               \
+			}                                                \
+			VECTOR_DATA(THIS)[_vi_index] = ELEMENT;          \
+		}                                                    \
+		_vi_ret;                                             \
 	})
 
-#define VECTOR_REMOVE_BY_INDEX(THIS, INDEX)                       \
-	({                                                            \
-		__label__ _ret;                                           \
-		if ((THIS).length < (INDEX)) {                            \
-			goto _ret;                                            \
-		}                                                         \
-		for (size_t _i = (INDEX) + 1; _i < (THIS).length; _i++) { \
-			(THIS).data[_i - 1] = (THIS).data[_i];                \
-		}                                                         \
-		(THIS).length--;                                          \
-_ret:                                                             \
+// Remove COUNT elements starting at INDEX, keeping the order of the rest.
+#define VECTOR_ERASE_RANGE(THIS, INDEX, COUNT)             \
+	({                                                     \
+		__label__ _ve_out;                                 \
+		int _ve_ret = -1;                                  \
+		size_t _ve_index = (INDEX);                        \
+		size_t _ve_count = (COUNT);                        \
+		if (_ve_index > (THIS).length ||                   \
+			_ve_count > (THIS).length - _ve_index)         \
+			goto _ve_out;                                  \
+		memmove(VECTOR_DATA(THIS) + _ve_index,             \
+				VECTOR_DATA(THIS) + _ve_index + _ve_count, \
+				((THIS).length - _ve_index - _ve_count) *  \
+					sizeof(*(THIS).data));                 \
+		(THIS).length -= _ve_count;                        \
+		_ve_ret = 0;                                       \
+_ve_out:                                                   \
+		_ve_ret;                                           \
+	})
+
+#define VECTOR_REMOVE_BY_INDEX(THIS, INDEX) VECTOR_ERASE_RANGE(THIS, INDEX, 1)
+
+// Remove the element at INDEX in O(1) by moving the last element into its
+// place. Does not preserve order.
+#define VECTOR_SWAP_REMOVE(THIS, INDEX)                                        \
+	({                                                                         \
+		int _vs_ret = -1;                                                      \
+		size_t _vs_index = (INDEX);                                            \
+		if (_vs_index < (THIS).length) {                                       \
+			VECTOR_DATA(THIS)[_vs_index] = VECTOR_DATA(THIS)[--(THIS).length]; \
+			_vs_ret = 0;                                                       \
+		}                                                                      \
+		_vs_ret;                                                               \
 	})
 
 #define VECTOR_REMOVE_BY_VALUE(THIS, VALUE)       \
 	({                                            \
 		size_t _j = 0;                            \
 		for (; _j < (THIS).length; _j++) {        \
-			if ((THIS).data[_j] == VALUE) {       \
+			if (VECTOR_DATA(THIS)[_j] == VALUE) { \
 				VECTOR_REMOVE_BY_INDEX(THIS, _j); \
 				break;                            \
 			}                                     \
@@ -96,20 +190,52 @@ _ret:                                                             \
 		_j;                                       \
 	})
 
-#define VECTOR_POP(THIS, RET)                   \
-	({                                          \
-		int _status = 0;                        \
-		if ((THIS).length <= 0) {               \
-			_status = -1;                       \
-		} else {                                \
-			RET = (THIS).data[--(THIS).length]; \
-		}                                       \
-		_status;                                \
+#define VECTOR_POP(THIS, RET)                         \
+	({                                                \
+		int _status = 0;                              \
+		if ((THIS).length <= 0) {                     \
+			_status = -1;                             \
+		} else {                                      \
+			RET = VECTOR_DATA(THIS)[--(THIS).length]; \
+		}                                             \
+		_status;                                      \
+	})
+
+// Move the elements back inline if they fit there, or otherwise to a
+// right-sized allocation, since realloc never shrinks an object.
+#define VECTOR_SHRINK_TO_FIT(THIS)                            \
+	({                                                        \
+		__label__ _vt_out;                                    \
+		int _vt_ret = 0;                                      \
+		if ((THIS).data == NULL)                              \
+			goto _vt_out;                                     \
+		if ((THIS).length <= VECTOR_INLINE_CAPACITY(THIS)) {  \
+			memcpy((THIS).inline_data, (THIS).data,           \
+				   (THIS).length * sizeof(*(THIS).data));     \
+			free((THIS).data);                                \
+			(THIS).data = NULL;                               \
+			(THIS).buffer_capacity = 0;                       \
+		} else if ((THIS).length < (THIS).buffer_capacity) {  \
+			__typeof__((THIS).data) _vt_data =                \
+				alloc((THIS).length * sizeof(*(THIS).data));  \
+			if (_vt_data == NULL) {                           \
+				_vt_ret = -1;                                 \
+			} else {                                          \
+				memcpy(_vt_data, (THIS).data,                 \
+					   (THIS).length * sizeof(*(THIS).data)); \
+				free((THIS).data);                            \
+				(THIS).data = _vt_data;                       \
+				(THIS).buffer_capacity = (THIS).length;       \
+			}                                                 \
+		}                                                     \
+_vt_out:                                                      \
+		_vt_ret;                                              \
 	})
 
-#define VECTOR_CLEAR(THIS) \
-	free((THIS).data);     \
-	(THIS).length = 0;     \
+#define VECTOR_CLEAR(THIS)      \
+	free((THIS).data);          \
+	(THIS).data = NULL;         \
+	(THIS).length = 0;          \
 	(THIS).buffer_capacity = 0;
 
 #endif